@@ -4,9 +4,11 @@ function(add_tart_library LibName SourceRoot SourceFiles)
   include(${CMAKE_CURRENT_BINARY_DIR}/lib${LibName}.deps OPTIONAL)
 
   set(BC_FILES)
+  set(IFACE_FILES)
   foreach(SRC_FILE ${SourceFiles})
     # Construct the name of the output file from the source file
     string(REGEX REPLACE ".tart\$" ".bc" OUT_FILE "${SRC_FILE}")
+    string(REGEX REPLACE ".tart\$" ".iface" IFACE_FILE "${SRC_FILE}")
 
     # Generate the deps variable name
     string(REGEX REPLACE ".tart\$" "" DEPS_NAME "${SRC_FILE}")
@@ -15,27 +17,45 @@ function(add_tart_library LibName SourceRoot SourceFiles)
 
     add_custom_command(
         OUTPUT ${OUT_FILE}
-        COMMAND tartc ${TARTC_OPTIONS} -sourcepath ${SourceRoot} ${TART_MODULE_PATH} ${SRC_FILE}
-        DEPENDS "${SourceRoot}/${SRC_FILE}" tartc ${${DEPS_NAME}_DEPS}
+        COMMAND ${TARTC_COMMAND} ${TARTC_OPTIONS} -sourcepath ${SourceRoot} ${TART_MODULE_PATH}
+            ${SRC_FILE}
+        DEPENDS "${SourceRoot}/${SRC_FILE}" ${TARTC_DEPENDS} ${${DEPS_NAME}_DEPS}
         COMMENT "Compiling Tart source file ${SRC_FILE}")
 
+    # The interface fingerprint is only rewritten when it changes, so that modules which
+    # import this one are only recompiled when its interface changes. The stamp records
+    # that the check has been done; without it the check would rerun on every build.
+    add_custom_command(
+        OUTPUT ${IFACE_FILE}.stamp
+        COMMAND gendeps -fingerprint -o ${IFACE_FILE} ${OUT_FILE}
+        COMMAND ${CMAKE_COMMAND} -E touch ${IFACE_FILE}.stamp
+        DEPENDS ${OUT_FILE} gendeps
+        COMMENT "Checking the interface of ${SRC_FILE}")
+    add_custom_command(OUTPUT ${IFACE_FILE} DEPENDS ${IFACE_FILE}.stamp)
+
     # Remember the list of output files.
     set(BC_FILES ${BC_FILES} "${OUT_FILE}")
+    set(IFACE_FILES ${IFACE_FILES} "${IFACE_FILE}")
   endforeach(SRC_FILE)
 
   # Link phase
   add_custom_command(
-      OUTPUT lib${LibName}.bc
+      OUTPUT lib${LibName}.bc lib${LibName}.tif
       COMMAND ${LLVM_LD} -link-as-library -disable-opt -o lib${LibName}.bc ${BC_FILES}
       #COMMAND tartln -filetype=bc -link-as-library -o lib${LibName}.bc ${BC_FILES}
-      DEPENDS ${BC_FILES} tartln
+      COMMAND gendeps -interface -o lib${LibName}.tif lib${LibName}.bc
+      DEPENDS ${BC_FILES} tartln gendeps
       COMMENT "Linking lib${LibName}.bc")
   
-  # Generate dependency info
+  # Generate dependency info. Like the interface files, the .deps file is only rewritten
+  # when it changes, so a stamp records when it was last generated.
   add_custom_command(
-      OUTPUT lib${LibName}.deps
-      COMMAND gendeps -o lib${LibName}.deps ${BC_FILES}
-      DEPENDS ${BC_FILES} gendeps
+      OUTPUT lib${LibName}.deps.stamp
+      COMMAND gendeps -source-root ${SourceRoot} -iface-dir ${CMAKE_CURRENT_BINARY_DIR}
+          -o lib${LibName}.deps ${BC_FILES}
+      COMMAND ${CMAKE_COMMAND} -E touch lib${LibName}.deps.stamp
+      DEPENDS ${BC_FILES} ${IFACE_FILES} gendeps
       COMMENT "Generating dependencies for lib${LibName}.bc")
+  add_custom_command(OUTPUT lib${LibName}.deps DEPENDS lib${LibName}.deps.stamp)
 
 endfunction(add_tart_library)
@@ -1,11 +1,12 @@
-# AddTartTest - defines the "add_tart_test" function
+# AddTartTest - defines the "add_tart_executable" and "add_tart_test" functions
 
 set(TARTC_FLAGS
   -debug-errors
   -nostdlib # Don't look for stdlib in it's installed location
 )
 
-function(add_tart_test TEST_NAME SRCLIST_VAR)
+# Compile and link a Tart program from a list of source files.
+function(add_tart_executable TEST_NAME SRCLIST_VAR)
   include(${CMAKE_CURRENT_BINARY_DIR}/${TEST_NAME}.deps OPTIONAL)
 
   set(LNK_BC_FILE "${TEST_NAME}.lnk.bc")
@@ -33,9 +34,9 @@ function(add_tart_test TEST_NAME SRCLIST_VAR)
 
     # Compile tart source
     add_custom_command(OUTPUT ${BC_FILE}
-        COMMAND tartc ${TARTC_FLAGS} -sourcepath ${SRCDIR} ${MODPATH} "${SRC_FILE}"
+        COMMAND ${TARTC_COMMAND} ${TARTC_FLAGS} -sourcepath ${SRCDIR} ${MODPATH} "${SRC_FILE}"
         MAIN_DEPENDENCY "${SRC_FILE}"
-        DEPENDS ${BC_LIBS} ${${DEPS_NAME}_DEPS}
+        DEPENDS ${BC_LIBS} ${TARTC_DEPENDS} ${${DEPS_NAME}_DEPS}
         COMMENT "Compiling Tart source file ${SRC_FILE}")
 
     # Remember the list of output files.
@@ -80,7 +81,13 @@ function(add_tart_test TEST_NAME SRCLIST_VAR)
   add_executable(${EXE_FILE} EXCLUDE_FROM_ALL ${OBJ_FILE})
   add_dependencies(${EXE_FILE} ${LIB_DEPS})
   target_link_libraries(${EXE_FILE} ${TEST_CLIBS})
+endfunction(add_tart_executable)
+
+# Build a Tart test program, and run it as part of the 'check' target.
+function(add_tart_test TEST_NAME SRCLIST_VAR)
+  add_tart_executable(${TEST_NAME} ${SRCLIST_VAR})
 
+  set(EXE_FILE "${TEST_NAME}${CMAKE_EXECUTABLE_SUFFIX}")
   add_custom_target(${TEST_NAME}.run COMMAND ./${EXE_FILE} DEPENDS ${EXE_FILE} ${TEST_NAME}.deps)
   add_dependencies(check ${TEST_NAME}.run)
 endfunction(add_tart_test)
@@ -71,6 +71,9 @@ protected:
   SourceLocation loc;
 
 public:
+  /** Syntax trees are allocated in the arena of the module being parsed. */
+  void * operator new(size_t size) { return GC::arenaAlloc(size); }
+
   ASTNode(NodeType nt, const SourceLocation & sl)
     : nodeType_(nt)
     , loc(sl)
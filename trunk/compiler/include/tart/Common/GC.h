@@ -19,6 +19,7 @@ namespace tart {
 
 class GCRootBase;
 class GCWeakPtrBase;
+class GCArena;
 
 /// -------------------------------------------------------------------
 /// Base class of garbage-collectable objects
@@ -27,6 +28,11 @@ public:
   void * operator new(size_t size);
   void operator delete(void * mem);
 
+  /** Allocate an object in the current arena, or on the heap if there is no current
+      arena. Classes whose instances tend to die together can use this as their
+      operator new. */
+  static void * arenaAlloc(size_t size);
+
   class Callback {
   public:
     virtual void call() = 0;
@@ -109,6 +115,7 @@ public:
 private:
   friend class GCRootBase;
   friend class GCWeakPtrBase;
+  friend class GCArena;
 
   typedef llvm::SmallVector<GC::Callback *, 8> CallbackList;
   typedef llvm::SmallVector<GCWeakPtrBase *, 128> WeakPtrList;
@@ -119,12 +126,74 @@ private:
 
   static unsigned char cycleIndex_;
   static GC * allocList_;
+  static GCArena * arenas_;
   static GCRootBase * roots_;
   static CallbackList uninitCallbacks_;
   static WeakPtrList weakPtrs_;
   static ObjectList toTrace_;
 };
 
+/// -------------------------------------------------------------------
+/// A region in which GC objects can be allocated. Allocation is a pointer bump,
+/// and the objects in an arena are never swept individually: once the arena has
+/// been released by its owner, all of its objects are freed together by the first
+/// sweep in which none of them are reachable. Until then the sweep skips the arena
+/// entirely. Objects in an arena are traced like any other, so reachable ones may
+/// freely refer to (and be referred to by) heap objects.
+///
+/// An arena object which becomes unreachable is not traced, but it isn't freed
+/// until its whole arena is. Heap objects which only it refers to are freed in the
+/// meantime, so its fields may hold dangling pointers. Such an object must never be
+/// made reachable again, and its destructor must not follow its references.
+class GCArena {
+public:
+  GCArena();
+
+  /** Indicate that the owner of this arena no longer needs it. */
+  void release() { released_ = true; }
+
+  /** The arena which objects are currently allocated in, or NULL. */
+  static GCArena * current() { return current_; }
+
+  /// Makes an arena the current one for the extent of the scope.
+  class Scope {
+  public:
+    Scope(GCArena * arena) : saved_(current_) { current_ = arena; }
+    ~Scope() { current_ = saved_; }
+
+  private:
+    GCArena * saved_;
+  };
+
+private:
+  friend class GC;
+  struct Block;
+
+  ~GCArena();
+
+  /** Allocate memory for an object, and add it to the list of objects in this arena. */
+  GC * allocate(size_t size);
+
+  /** Add a new block with room for 'size' bytes, and return the start of that space. */
+  char * addBlock(size_t size);
+
+  /** Clear the marks of all objects in this arena. Called when the cycle index wraps
+      around, so that no stale mark can match the new index. */
+  void clearMarks();
+
+  /** Called at the end of a sweep. Returns true if the arena can be deleted. */
+  bool sweep();
+
+  Block * blocks_;
+  char * ptr_;
+  char * end_;
+  GC * objects_;
+  bool released_;
+  GCArena * next_;
+
+  static GCArena * current_;
+};
+
 /// -------------------------------------------------------------------
 /// Base class for garbage collection roots.
 class GCRootBase {
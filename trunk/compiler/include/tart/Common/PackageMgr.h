@@ -11,6 +11,7 @@
 
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/TimeValue.h"
 
 #include <vector>
 #include <list>
@@ -19,6 +20,7 @@ namespace tart {
 
 class Module;
 class Package;
+class InterfaceFile;
 
 /// -------------------------------------------------------------------
 /// Represents a location where modules can be found.
@@ -46,24 +48,33 @@ private:
 };
 
 /// -------------------------------------------------------------------
-/// An import path which points to a library archive.
+/// An import path which points to a library archive. If there is an up
+/// to date interface file (.tif) next to the library, module interfaces
+/// are read from that instead of from the library's bitcode.
 
 class ArchiveImporter : public Importer {
 public:
   ArchiveImporter(StringRef path)
     : path_(path)
     , archive_(NULL)
+    , interface_(NULL)
     , archiveSource_(NULL)
     , valid_(true) {}
 
+  ~ArchiveImporter();
+
   // Overrides
 
   bool load(StringRef qualifiedName, Module *& module);
   void trace() const { safeMark(archiveSource_); }
 
 private:
+  /** Open the interface file or the library. Returns false if neither could be read. */
+  bool open();
+
   llvm::SmallString<128> path_;
   llvm::Module * archive_;
+  InterfaceFile * interface_;
   ProgramSource * archiveSource_;
   bool valid_;
 };
@@ -88,6 +99,10 @@ public:
   /** Get the module from the module cache using this exact name. */
   Module * getCachedModule(StringRef moduleName);
 
+  /** Return true if the source file or library of any cached module has been modified
+      since 'time', or can no longer be read. */
+  bool isModifiedSince(const llvm::sys::TimeValue & time) const;
+
   /** Return the singleton instance. */
   static PackageMgr & get() { return instance_; }
 
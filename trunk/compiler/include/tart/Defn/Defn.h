@@ -29,11 +29,14 @@
 #include "tart/Common/Formattable.h"
 #endif
 
+#ifndef TART_META_NODEREF_H
+#include "tart/Meta/NodeRef.h"
+#endif
+
 namespace llvm {
 class Value;
 class Function;
 class Type;
-class MDNode;
 }
 
 namespace tart {
@@ -92,7 +95,7 @@ protected:
   SourceLocation loc;         // Location where this was defined.
   StringRef name_;            // Local name (copied from decl)
   const ASTDecl * ast_;       // The source declaration of this defintion
-  const llvm::MDNode * md_;   // Metadata node.
+  NodeRef md_;                // Metadata node.
   DeclModifiers modifiers_;   // Modifier flags
   StorageClass storage_;      // Storage class for the defn.
   Module * module_;           // Module in which this symbol is defined.
@@ -142,8 +145,8 @@ public:
   }
 
   /** Get the Metadata node that declared this definition. */
-  const llvm::MDNode * mdNode() const { return md_; }
-  void setMDNode(const llvm::MDNode * md) { md_ = md; }
+  const NodeRef & mdNode() const { return md_; }
+  void setMDNode(const NodeRef & md) { md_ = md; }
 
   /** Get the source location where this definition was defined. */
   const SourceLocation & location() const;
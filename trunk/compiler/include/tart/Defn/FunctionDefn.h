@@ -120,6 +120,8 @@ public:
     Intrinsic = (1<<12),        // This function is an intrinsic
     TraceMethod = (1<<13),      // This overrides the compiler-generated trace strategy
     ReadOnlySelf = (1<<14),     // Guarantees no mutations to 'self'.
+    SelfNoEscape = (1<<15),     // Doesn't retain 'self' after returning.
+    EscapeAnalyzed = (1<<16),   // SelfNoEscape has been computed.
     //Commutative = (1<<6),  // A function whose order of arguments can be reversed
     //Associative = (1<<7),  // A varargs function that can be combined with itself.
   };
@@ -218,6 +220,7 @@ public:
   bool isIntrinsic() const { return (flags_ & Intrinsic) != 0; }
   bool isTraceMethod() const { return (flags_ & TraceMethod) != 0; }
   bool isReadOnlySelf() const { return (flags_ & ReadOnlySelf) != 0; }
+  bool isSelfNoEscape() const { return (flags_ & SelfNoEscape) != 0; }
   bool hasSafePoints() const { return (flags_ & HasSafePoints) != 0; }
 
   /** True if this function has a body. */
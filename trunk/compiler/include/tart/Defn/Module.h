@@ -85,6 +85,8 @@ public:
   /** Construct a builtin module. */
   Module(ProgramSource * src, StringRef qual);
 
+  ~Module();
+
   void createMembers();
 
   /** List of import statements. */
@@ -101,6 +103,9 @@ public:
   const ASTDeclList & astMembers() const { return decls_; }
   ASTDeclList & astMembers() { return decls_; }
 
+  /** The arena in which the syntax trees of this module are allocated. */
+  GCArena * astArena();
+
   /** Get the qualified name of this module's package. */
   StringRef packageName() const { return packageName_; }
 
@@ -222,6 +227,8 @@ private:
 
   // The LLVM module
   llvm::Module * irModule_;
+
+  GCArena * astArena_;
 };
 
 }
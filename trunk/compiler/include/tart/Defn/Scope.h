@@ -71,18 +71,46 @@ public:
 
 typedef llvm::SetVector<Scope *> ScopeSet;
 
+/// -------------------------------------------------------------------
+/// Creates the members of a scope on demand. Used for scopes whose members
+/// are read from a compiled module, so that only the members which are
+/// actually referenced get built.
+class MemberLoader {
+public:
+  MemberLoader() : loadingAll_(false) {}
+  virtual ~MemberLoader() {}
+
+  /** Create the members named 'name' which have not been created yet. */
+  virtual void loadMembers(StringRef name) = 0;
+
+  /** Create all of the members which have not been created yet. 'members' is
+      filled in with every member created by this loader, in declaration order. */
+  virtual void loadAllMembers(DefnList & members) = 0;
+
+  /** True while 'loadAllMembers' is running. */
+  bool isLoadingAll() const { return loadingAll_; }
+  void setLoadingAll(bool loading) { loadingAll_ = loading; }
+
+private:
+  bool loadingAll_;
+};
+
 /// -------------------------------------------------------------------
 /// An implementation of a scope.
 class IterableScope : public Scope {
 public:
   IterableScope()
       : parentScope_(NULL)
+      , memberLoader_(NULL)
   {}
 
   IterableScope(Scope * parent)
       : parentScope_(parent)
+      , memberLoader_(NULL)
   {}
 
+  ~IterableScope() { delete memberLoader_; }
+
   /** Get the scope which encloses this one. */
   Scope * parentScope() const;
 
@@ -90,28 +118,47 @@ public:
   void setParentScope(Scope * parent);
 
   /** Return the first symbol in this scope. */
-  Defn * firstMember() const { return members_.first(); }
+  Defn * firstMember() const {
+    loadAllMembers();
+    return members_.first();
+  }
 
   /** Return the symbol table entry for the specified symbol name. */
   const SymbolTable::Entry * findSymbol(const char * key) const {
+    loadMembers(key);
     return members_.findSymbol(key);
   }
 
+  /** Set the loader which creates the members of this scope on demand. The
+      scope takes ownership of the loader. */
+  void setMemberLoader(MemberLoader * loader);
+
   /** Auxiliary scopes associated with this one. */
   const ScopeSet & auxScopes() const { return auxScopes_; }
   ScopeSet & auxScopes() { return auxScopes_; }
 
   /** Return a reference to the symbol table. */
-  const SymbolTable & members() const { return members_; }
-  SymbolTable & members() { return members_; }
+  const SymbolTable & members() const {
+    loadAllMembers();
+    return members_;
+  }
+
+  SymbolTable & members() {
+    loadAllMembers();
+    return members_;
+  }
 
   // Overrides
 
   void addMember(Defn * d);
   bool lookupMember(llvm::StringRef ident, DefnList & defs, bool inherit) const;
   bool allowOverloads() { return true; }
-  size_t count() { return members_.count(); }
-  void clear() { members_.clear(); }
+  size_t count() {
+    loadAllMembers();
+    return members_.count();
+  }
+
+  void clear();
   void trace() const;
   void setScopeName(StringRef name) {
 #ifndef NDEBUG
@@ -121,9 +168,26 @@ public:
   void dumpHierarchy(bool full) const;
 
 private:
+  /** Create any members named 'name' which haven't been created yet. */
+  void loadMembers(StringRef name) const {
+    if (memberLoader_ != NULL) {
+      memberLoader_->loadMembers(name);
+    }
+  }
+
+  /** Create all members which haven't been created yet. */
+  void loadAllMembers() const {
+    if (memberLoader_ != NULL && !memberLoader_->isLoadingAll()) {
+      const_cast<IterableScope *>(this)->finishLoading();
+    }
+  }
+
+  void finishLoading();
+
   OrderedSymbolTable members_;
   Scope * parentScope_;
   ScopeSet auxScopes_;
+  MemberLoader * memberLoader_;
 
 #ifndef NDEBUG
   // For debugging
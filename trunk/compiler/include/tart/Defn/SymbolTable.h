@@ -86,6 +86,10 @@ public:
   /** Get the first decl in the list by order. */
   Defn * first() const { return first_; }
 
+  /** Move the decls in 'leading' to the start of the list, in the order given.
+      The remaining decls keep their relative order. */
+  void moveToFront(const DefnList & leading);
+
 private:
   Defn * first_;
   Defn * last_;
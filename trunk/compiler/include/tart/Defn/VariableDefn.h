@@ -30,6 +30,7 @@ public:
     Extern = (1<<2),            // Variable is external to this module
     AssignedTo = (1<<3),        // Variable is assigned to (local vars only)
     ClosureVar = (1<<4),        // Variable is a member of a closure environment
+    StackObject = (1<<5),       // Variable refers to an object on the stack
   };
 
   typedef tart::PassMgr<AnalysisPass, PassCount> PassMgr;
@@ -91,6 +92,10 @@ public:
   bool isClosureVar() const { return getFlag(ClosureVar); }
   void setClosureVar(bool value) { setFlag(ClosureVar, value); }
 
+  /** True if this is a local variable that only ever refers to an object allocated in
+      the stack frame, so it need not be a garbage collection root. */
+  bool isStackObject() const { return getFlag(StackObject); }
+
   /** If this variable is a closure variable, then return the outer variable that it
       is bound to. */
   VariableDefn * closureBinding() const;
@@ -355,8 +355,14 @@ class NewExpr : public Expr {
 public:
   NewExpr(const SourceLocation & loc, QualifiedType type)
     : Expr(New, loc, type)
+    , stackAlloc_(false)
   {}
 
+  /** True if the new object can be allocated in the stack frame, because it is
+      known not to outlive the function that creates it. */
+  bool isStackAlloc() const { return stackAlloc_; }
+  void setStackAlloc(bool stackAlloc) { stackAlloc_ = stackAlloc; }
+
   // Overridden methods
   void format(FormatStream & out) const;
   bool isSideEffectFree() const { return true; }
@@ -365,6 +371,9 @@ public:
   static inline bool classof(const Expr * ex) {
     return ex->exprType() == New;
   }
+
+private:
+  bool stackAlloc_;
 };
 
 /// -------------------------------------------------------------------
@@ -9,6 +9,7 @@
 #include "tart/Common/Formattable.h"
 #include "tart/Meta/NameTable.h"
 #include "tart/Gen/Reflector.h"
+#include "tart/Gen/TypeInfoBlock.h"
 
 #include "llvm/Support/IRBuilder.h"
 #include "llvm/PassManager.h"
@@ -30,6 +31,7 @@ namespace tart {
 
 class ASTNode;
 class ASTDecl;
+class MDWriter;
 class Module;
 class Expr;
 class CastExpr;
@@ -172,15 +174,6 @@ private:
 /// Code generator class.
 class CodeGenerator {
 public:
-  // Field indices for TypeInfoBlock
-  enum TIBFields {
-    TIB_META = 0,
-    TIB_TRACE_TABLE,
-    TIB_BASES,
-    TIB_IDISPATCH,
-    TIB_METHOD_TABLE,
-  };
-
   CodeGenerator(Module * mod);
 
   /** Return the builder object. */
@@ -230,6 +223,18 @@ public:
   void pushRoots(LocalScope * scope);
   void popRootStack(size_t level = 0);
 
+  /** Store 'value' into 'slot', a reference field of 'object', via the llvm.gcwrite
+      intrinsic so that the collector's write barrier is applied. */
+  void genWriteBarrierStore(llvm::Value * value, llvm::Value * object, llvm::Value * slot);
+
+  /** Apply the write barrier to each reference within the aggregate value of type 'type'
+      at 'addr', in preparation for overwriting it. */
+  void genAggregateWriteBarriers(const Type * type, llvm::Value * object, llvm::Value * addr);
+
+  /** Apply the write barrier to the 'count' elements of type 'elemType' at 'first', which
+      are about to be overwritten by a bulk copy. */
+  void genWriteBarrierRange(const Type * elemType, llvm::Value * first, llvm::Value * count);
+
   /** Generate the function body from the basic block list. */
   bool genTestExpr(const Expr * test, llvm::BasicBlock * trueBlk, llvm::BasicBlock * falseBlk);
 
@@ -243,6 +248,17 @@ public:
   llvm::Value * genSwitch(const SwitchExpr * in);
   llvm::Value * genIntegerSwitch(const SwitchExpr * in);
   llvm::Value * genEqSwitch(const SwitchExpr * in);
+  llvm::Value * genHashSwitch(const SwitchExpr * in);
+
+  /** Generate a case body of a switch which has been lowered to a chain of tests. If the
+      body falls through, branch to 'blkDone', creating it if need be, and add the result
+      to 'phi'. */
+  void genCaseBody(const Expr * body, llvm::PHINode * phi, llvm::BasicBlock *& blkDone);
+
+  /** Generate the 'else' case of such a switch at the current insertion point, followed
+      by the block where the cases merge. Returns the value of the switch. */
+  llvm::Value * genSwitchEnd(const SwitchExpr * in, llvm::PHINode * phi,
+      llvm::BasicBlock * blkDone, size_t savedRootCount);
   llvm::Value * genMatch(const MatchExpr * in);
   llvm::Value * genTry(const TryExpr * in);
   llvm::Value * genThrow(const ThrowExpr * in);
@@ -280,6 +296,7 @@ public:
   llvm::Value * genCall(const FnCallExpr * in);
   llvm::Value * genIndirectCall(const IndirectCallExpr * in);
   llvm::Value * genNew(const NewExpr * in);
+  llvm::Value * genStackAlloc(const CompositeType * ctdef);
   llvm::Value * defaultAlloc(const tart::Expr * size);
   llvm::Value * genCompositeCast(llvm::Value * in, const CompositeType * fromCls,
       const CompositeType * toCls, bool throwOnFailure);
@@ -290,6 +307,22 @@ public:
   /** Get the address of a value. */
   llvm::Value * genLValueAddress(const Expr * in);
 
+  /** Get the address of a value that is about to be assigned to. If the value contains
+      references and may live inside a heap object, then 'object' is set to the object
+      (or an address within it, or a null pointer if the object is not known) so that the
+      store can be given a write barrier; otherwise 'object' is set to NULL. */
+  llvm::Value * genStoreAddress(const Expr * in, llvm::Value *& object);
+
+  /** Where the storage referred to by an lvalue expression lives. */
+  enum StoreLocation {
+    Store_Local,      // A local or static variable, never in the heap.
+    Store_Heap,       // Within a heap object which can be determined statically.
+    Store_Unknown,    // Reached through a pointer, so possibly within a heap object.
+  };
+
+  /** Return where the storage referred to by the lvalue expression 'in' lives. */
+  StoreLocation storeLocation(const Expr * in);
+
   /** Load the value of a member field. */
   llvm::Value * genLoadMemberField(const LValueExpr * lval, bool derefShared);
 
@@ -355,6 +388,25 @@ public:
   /** Generate the interface dispatcher function. */
   llvm::Function * genInterfaceDispatchFunc(const CompositeType * ctype);
 
+  /** Generate the hash table which maps the interfaces implemented by a type to their
+      method tables, returning a pointer to the first slot. 'mask' is set to the number
+      of slots minus one. */
+  llvm::Constant * genInterfaceTable(const CompositeType * ctype, int32_t & mask);
+
+  /** Get or create the table of methods which implement interface 'iftype' in a type. */
+  llvm::GlobalVariable * getInterfaceMethodTable(const CompositeType * ctype,
+      const CompositeType * iftype, const MethodList & methods);
+
+  /** Return the hash used to place an interface in an interface table. It must not vary
+      between compilations, since call sites and tables may be in different modules. */
+  static uint32_t interfaceHash(const CompositeType * iftype);
+
+  /** Return the bit which represents an interface in the 'interfaceBits' field of a TIB. */
+  static uint64_t interfaceBit(const CompositeType * iftype);
+
+  /** Return the depth of a class in the class hierarchy, where Object is at depth 0. */
+  static int32_t classDepth(const CompositeType * cls);
+
   /** Generate the code to initialize the vtable pointer of a newly-allocated class instance. */
   void genInitObjVTable(const CompositeType * tdef, llvm::Value * instance);
 
@@ -395,6 +447,11 @@ public:
   /** return a reference to the global gc_alloc function (allocates memory in the nursery space). */
   llvm::Function * getGcAlloc();
 
+  /** Allocate 'size' bytes from the collected heap. The common case, where the object fits
+      in the current thread's allocation buffer, is done inline; otherwise gc_alloc is
+      called to refill the buffer. */
+  llvm::Value * genGcAlloc(llvm::Value * size, const llvm::Twine & name);
+
   /** Generate data structures for a string literal. */
   llvm::Constant * genStringLiteral(StringRef strval, StringRef symName = "");
 
@@ -516,6 +573,8 @@ public:
   llvm::MDNode * getModuleSource();
   llvm::MDNode * getModuleDeps();
   llvm::MDNode * getModuleTimestamp();
+  llvm::MDNode * getInterfaceFingerprint(const MDWriter & writer,
+      llvm::ArrayRef<llvm::MDNode *> nodes);
 
 private:
   typedef llvm::StringMap<llvm::DIFile> DIFileMap;
@@ -591,7 +650,10 @@ private:
 
   void markGCRoot(llvm::Value * value, llvm::Constant * metadata, StringRef rootName = StringRef());
 
-  llvm::Value * doAssignment(const AssignmentExpr * in, llvm::Value * lvalue, llvm::Value * rvalue);
+  llvm::Value * doAssignment(const AssignmentExpr * in, llvm::Value * lvalue, llvm::Value * rvalue,
+      llvm::Value * object = NULL);
+  void genStore(const Expr * lvalExpr, llvm::Value * rvalue, llvm::Value * lvalue,
+      llvm::Value * object);
 
   llvm::LLVMContext & context_;
   llvm::IRBuilder<true> builder_;    // LLVM builder
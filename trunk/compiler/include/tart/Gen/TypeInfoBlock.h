@@ -0,0 +1,28 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_GEN_TYPEINFOBLOCK_H
+#define TART_GEN_TYPEINFOBLOCK_H
+
+namespace tart {
+
+/// Field indices of tart.core.TypeInfoBlock, used both by the code generator and by the
+/// linker passes which read the TIBs it emits.
+enum TIBFields {
+  TIB_META = 0,
+  TIB_TRACE_TABLE,
+  TIB_BASES,
+  TIB_DISPLAY,
+  TIB_INTERFACE_BITS,
+  TIB_DEPTH,
+  TIB_IDISPATCH,
+  TIB_ITABLE,
+  TIB_ITABLE_MASK,
+  TIB_METHOD_TABLE,
+  TIB_FIELD_COUNT,
+};
+
+} // namespace tart
+
+#endif // TART_GEN_TYPEINFOBLOCK_H
@@ -0,0 +1,161 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_META_INTERFACEFILE_H
+#define TART_META_INTERFACEFILE_H
+
+#ifndef LLVM_ADT_STRINGREF_H
+#include "llvm/ADT/StringRef.h"
+#endif
+
+#ifndef LLVM_ADT_STRINGMAP_H
+#include "llvm/ADT/StringMap.h"
+#endif
+
+#ifndef LLVM_ADT_DENSEMAP_H
+#include "llvm/ADT/DenseMap.h"
+#endif
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/DataTypes.h"
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+class MemoryBuffer;
+class MDNode;
+class NamedMDNode;
+class Value;
+class raw_ostream;
+}
+
+namespace tart {
+
+using llvm::StringRef;
+
+/// -------------------------------------------------------------------
+/// A module interface file (.tif), which holds the same tree of nodes as the
+/// 'tart.xdef' metadata of a library, in a form which can be mapped into
+/// memory and read in place. Importing a module from it only requires a
+/// lookup in the module index; nodes and strings are decoded as they are
+/// accessed.
+///
+/// All fields are little-endian 32-bit words:
+///
+///   Header:        magic, version, stringCount, stringIndexOffset, nodeCount,
+///                  nodeIndexOffset, moduleCount, moduleIndexOffset
+///   String index:  { dataOffset, length } per string
+///   Node index:    { operandOffset, operandCount } per node
+///   Module index:  { nameString, rootNode } per module, sorted by name
+///   Operands:      { kind | bitWidth << 8, low word, high word } per operand
+///   String data
+///
+/// The root node of a module has the same operands as its 'tart.xdef'
+/// named metadata node.
+///
+/// Every index entry and operand reference is checked when the file is
+/// opened, so a truncated or corrupt file is rejected rather than read
+/// out of bounds.
+
+class InterfaceFile {
+public:
+  enum OperandKind {
+    OPERAND_NULL = 0,
+    OPERAND_INT,                // Integer constant
+    OPERAND_STRING,             // Index of a string
+    OPERAND_NODE,               // Index of a node
+    OPERAND_SYMBOL,             // Name of a global value, as a string index
+  };
+
+  enum {
+    MAGIC = 0x00464954,         // "TIF"
+    VERSION = 1,
+    HEADER_SIZE = 8 * 4,
+    OPERAND_SIZE = 3 * 4,
+  };
+
+  /** Map the interface file at 'path' into memory. Returns NULL and sets 'errorInfo'
+      if the file could not be read, or is not a valid interface file. */
+  static InterfaceFile * open(StringRef path, std::string & errorInfo);
+
+  /** Read an interface file from 'buffer', taking ownership of it. Returns NULL and sets
+      'errorInfo' if the buffer does not hold a valid interface file. */
+  static InterfaceFile * open(llvm::MemoryBuffer * buffer, std::string & errorInfo);
+
+  /** Find the root node of the module 'qualifiedName'. Returns false if this file
+      doesn't contain that module. */
+  bool findModule(StringRef qualifiedName, uint32_t & node) const;
+
+  /** Return the number of operands of 'node'. */
+  unsigned nodeSize(uint32_t node) const;
+
+  /** Return the kind of the nth operand of 'node'. */
+  OperandKind operandKind(uint32_t node, unsigned n) const;
+
+  /** Return the bit width and value of an integer operand. */
+  unsigned intWidth(uint32_t node, unsigned n) const;
+  uint64_t intValue(uint32_t node, unsigned n) const;
+
+  /** Return the value of a string or symbol operand. */
+  StringRef stringValue(uint32_t node, unsigned n) const;
+
+  /** Return the value of a node operand. */
+  uint32_t nodeValue(uint32_t node, unsigned n) const;
+
+private:
+  InterfaceFile(llvm::MemoryBuffer * buffer);
+
+  bool validate(std::string & errorInfo);
+  uint32_t word(uint32_t offset) const;
+  uint32_t operandOffset(uint32_t node, unsigned n) const;
+  StringRef string(uint32_t index) const;
+
+  llvm::OwningPtr<llvm::MemoryBuffer> buffer_;
+  const unsigned char * data_;
+  uint32_t stringCount_;
+  uint32_t stringIndex_;
+  uint32_t nodeCount_;
+  uint32_t nodeIndex_;
+  uint32_t moduleCount_;
+  uint32_t moduleIndex_;
+};
+
+/// -------------------------------------------------------------------
+/// Writes an interface file from the 'tart.xdef' metadata of a library.
+
+class InterfaceFileWriter {
+public:
+  /** Add the module 'qualifiedName', whose interface is 'md'. Returns false if the
+      metadata contains values which can't be stored in an interface file. */
+  bool addModule(StringRef qualifiedName, const llvm::NamedMDNode * md);
+
+  /** Write the interface file. */
+  void write(llvm::raw_ostream & out) const;
+
+private:
+  struct Operand {
+    uint32_t kind;
+    uint32_t width;
+    uint64_t value;
+  };
+
+  typedef std::vector<Operand> OperandList;
+  typedef llvm::DenseMap<const llvm::MDNode *, uint32_t> NodeIndexMap;
+  typedef std::vector<std::pair<std::string, uint32_t> > ModuleList;
+
+  bool addNode(const llvm::MDNode * node, uint32_t & index);
+  bool addOperand(const llvm::Value * value, Operand & result);
+  uint32_t addString(StringRef str);
+
+  llvm::StringMap<uint32_t> stringIndices_;
+  std::vector<StringRef> strings_;
+  NodeIndexMap nodeIndices_;
+  std::vector<OperandList> nodes_;
+  ModuleList modules_;
+};
+
+} // namespace tart
+
+#endif // TART_META_INTERFACEFILE_H
@@ -5,6 +5,10 @@
 #ifndef TART_META_MDREADER_H
 #define TART_META_MDREADER_H
 
+#ifndef TART_META_NODEREF_H
+#include "tart/Meta/NodeRef.h"
+#endif
+
 namespace llvm {
 class NamedMDNode;
 class MDNode;
@@ -16,67 +20,12 @@ namespace tart {
 class ASTTemplate;
 class Module;
 class Scope;
+class IterableScope;
 class Defn;
 class TypeDefn;
 class EnumType;
 class AttributeInfo;
 
-/// -------------------------------------------------------------------
-/// Helper class for reading metadata nodes.
-
-class NodeRef {
-public:
-  NodeRef() : node_(NULL) {}
-  NodeRef(const llvm::MDNode * node) : node_(node) {}
-  NodeRef(const NodeRef & nref) : node_(nref.node_) {}
-
-  NodeRef & operator=(const NodeRef & nref) {
-    node_ = nref.node_;
-    return *this;
-  }
-
-  NodeRef & operator=(const llvm::MDNode * node) {
-    node_ = node;
-    return *this;
-  }
-
-  /** Direct reference to the metadata node. */
-  const llvm::MDNode * node() const { return node_; }
-
-  /** Return the Nth argument of the node. May be null. */
-  llvm::Value * arg(unsigned n) const;
-
-  /** Whether this node reference is null. */
-  bool isNull() const { return node_ == NULL; }
-
-  /** Return the number of operands of the node. Returns 0 if
-      this reference is null. */
-  unsigned size() const;
-
-  /** Return the nth arg as an integer. Aborts if the nth argument
-      was null or the wrong type. */
-  uint32_t intArg(unsigned n) const;
-
-  /** Return the nth arg as a StringRef. Aborts if the nth argument
-      was null or the wrong type. */
-  StringRef strArg(unsigned n) const;
-
-  /** Return the nth arg as a StringRef, or an empty string if the
-      argument was NULL. */
-  StringRef optStrArg(unsigned n) const;
-
-  /** Return the nth arg as a NodeRef. Aborts if the nth argument was
-      null or the wrong type. */
-  NodeRef nodeArg(unsigned n) const;
-
-  /** Return the nth arg as a NodeRef. Can return a null NodeRef if
-      the argument was null. */
-  NodeRef optNodeArg(unsigned n) const;
-
-private:
-  const llvm::MDNode * node_;
-};
-
 /// -------------------------------------------------------------------
 /// Metadata reader.
 
@@ -144,14 +93,18 @@ public:
   /** Read the module-level data. */
   bool read(llvm::NamedMDNode * md);
 
+  /** Read the module-level data from the root node of a module in an interface file. */
+  bool read(NodeRef md);
+
   /** Read imports for the given definition. */
   bool readImports(Defn * de, ASTNodeList & imports);
 
   /** Read member definitions. */
   bool readMembers(Defn * parentDefn);
 
-  /** Read member definitions. */
-  bool readMembers(NodeRef members, Scope * scope, Defn * parentDefn);
+  /** Read member definitions. Only the names of the members are read here; each
+      definition is created the first time its name is looked up in 'scope'. */
+  bool readMembers(NodeRef members, IterableScope * scope, Defn * parentDefn);
 
   /** Read base classes for composite type. */
   bool readCompositeDetails(CompositeType * ty, TypeList & bases);
@@ -163,7 +116,7 @@ public:
   bool readEnumConstants(TypeDefn * ety);
 
   /** Read enum members. */
-  bool readTypeMembers(TypeDefn * tdef, Scope * memberScope);
+  bool readTypeMembers(TypeDefn * tdef, IterableScope * memberScope);
 
   /** Read template and function parameters for functions. */
   bool readFunctionType(FunctionDefn * fn);
@@ -187,9 +140,13 @@ public:
   ASTTemplate * readTemplate(SourceLocation loc, StringRef source, StringRef name);
 
 private:
+  friend class MDMemberLoader;
+
+  bool readModule(NodeRef version, NodeRef timestamp, NodeRef imports, NodeRef exports);
   bool readModuleImports(NodeRef node);
 
   Defn * readMember(NodeRef node, Scope * parent, StorageClass storage);
+  Defn * createMember(NodeRef node, Scope * scope, StorageClass storage);
 
   bool readAccessorList(PropertyDefn * prop, NodeRef node);
   bool readExpressionList(SourceLocation loc, NodeRef exprs, ExprList & out);
@@ -13,6 +13,8 @@
 #include "llvm/Support/IRBuilder.h"
 #endif
 
+#include "llvm/ADT/SmallPtrSet.h"
+
 namespace llvm {
 class NamedMDNode;
 class MDNode;
@@ -51,6 +53,10 @@ public:
   /** Return a node containing all the explicit imports for this module. */
   llvm::MDNode * moduleImports();
 
+  /** Return true if 'node' is the source location of a definition. Locations are not
+      part of the module's interface fingerprint. */
+  bool isLocation(const llvm::MDNode * node) const { return locations_.count(node) != 0; }
+
   /** The LLVM IR builder. */
   llvm::IRBuilder<true> & builder() { return builder_; }
 
@@ -90,6 +96,7 @@ private:
   llvm::IRBuilder<true> & builder_;
   llvm::LLVMContext & context_;
   bool needImports_;
+  llvm::SmallPtrSet<const llvm::MDNode *, 64> locations_;
 };
 
 } // namespace tart
@@ -0,0 +1,81 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_META_NODEREF_H
+#define TART_META_NODEREF_H
+
+#ifndef LLVM_ADT_STRINGREF_H
+#include "llvm/ADT/StringRef.h"
+#endif
+
+#include "llvm/Support/DataTypes.h"
+
+namespace llvm {
+class MDNode;
+class Value;
+class ConstantInt;
+}
+
+namespace tart {
+
+using llvm::StringRef;
+
+class InterfaceFile;
+
+/// -------------------------------------------------------------------
+/// Helper class for reading metadata nodes. The node can either be an
+/// LLVM metadata node, or a node in a module interface file.
+
+class NodeRef {
+public:
+  NodeRef() : md_(NULL), file_(NULL), index_(0) {}
+  NodeRef(const llvm::MDNode * node) : md_(node), file_(NULL), index_(0) {}
+  NodeRef(const InterfaceFile * file, uint32_t index) : md_(NULL), file_(file), index_(index) {}
+
+  /** Whether this node reference is null. */
+  bool isNull() const { return md_ == NULL && file_ == NULL; }
+
+  /** Return the number of operands of the node. Returns 0 if
+      this reference is null. */
+  unsigned size() const;
+
+  /** Return the nth arg as an integer. Aborts if the nth argument
+      was null or the wrong type. */
+  uint32_t intArg(unsigned n) const;
+
+  /** Return the nth arg as an LLVM integer constant. Aborts if the nth
+      argument was null or the wrong type. */
+  llvm::ConstantInt * constIntArg(unsigned n) const;
+
+  /** Return the nth arg as a StringRef. Aborts if the nth argument
+      was null or the wrong type. */
+  StringRef strArg(unsigned n) const;
+
+  /** Return the nth arg as a StringRef, or an empty string if the
+      argument was NULL. */
+  StringRef optStrArg(unsigned n) const;
+
+  /** Return the nth arg as a NodeRef. Aborts if the nth argument was
+      null or the wrong type. */
+  NodeRef nodeArg(unsigned n) const;
+
+  /** Return the nth arg as a NodeRef. Can return a null NodeRef if
+      the argument was null. */
+  NodeRef optNodeArg(unsigned n) const;
+
+private:
+  /** Return the Nth argument of a metadata node. May be null. */
+  llvm::Value * arg(unsigned n) const;
+
+  /** Report that the Nth argument isn't of the expected kind, and abort. */
+  void argError(unsigned n, const char * expected) const;
+
+  const llvm::MDNode * md_;
+  const InterfaceFile * file_;
+  uint32_t index_;
+};
+
+} // namespace tart
+
+#endif // TART_META_NODEREF_H
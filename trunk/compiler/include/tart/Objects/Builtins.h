@@ -85,6 +85,7 @@ public:
   static SystemClass typeStaticRoot;
   static SystemClass typeTraceAction;
   static SystemClass typeTraceDescriptor;
+  static SystemClass typeAllocContext;
 
   // System types - lazily loaded
   static SystemClass typeRef;
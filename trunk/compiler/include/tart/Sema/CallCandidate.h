@@ -39,6 +39,8 @@ class FunctionDefn;
 /// A call candidate
 class CallCandidate : public GC, public Formattable {
 public:
+  void * operator new(size_t size) { return GC::arenaAlloc(size); }
+
   CallCandidate(CallExpr * call, Expr * baseExpr, FunctionDefn * m,
       const ParameterAssignments & param, SpCandidate * spCandidate = NULL);
 
@@ -0,0 +1,73 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_SEMA_ESCAPEANALYSISPASS_H
+#define TART_SEMA_ESCAPEANALYSISPASS_H
+
+#ifndef TART_SEMA_CFGPASS_H
+#include "tart/Sema/CFGPass.h"
+#endif
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace tart {
+
+class VariableDefn;
+
+/// -------------------------------------------------------------------
+/// Function pass which finds objects that cannot outlive the call to the function which
+/// creates them, and marks their allocations so that they are placed on the stack.
+///
+/// An object qualifies if it is created by a constructor which does not retain 'self',
+/// and is used to initialize a local variable which is never assigned to, and which is
+/// only used to access the fields of the object, to compare it by reference, or as the
+/// 'self' argument of non-virtual methods which also don't retain 'self'. Taking the
+/// address of one of its fields counts as an escape.
+class EscapeAnalysisPass : public CFGPass {
+public:
+
+  /** Run this pass on the body of the specified function. */
+  static void run(FunctionDefn * in);
+
+  /** Return true if a call to 'fn' cannot retain a reference to its 'self' argument
+      after it returns. */
+  static bool isSelfNoEscape(FunctionDefn * fn);
+
+  Expr * visitLValue(LValueExpr * in);
+  Expr * visitFnCall(FnCallExpr * in);
+  Expr * visitRefEq(BinaryExpr * in);
+  Expr * visitInitVar(InitVarExpr * in);
+
+private:
+  typedef llvm::SmallPtrSet<const VariableDefn *, 16> VarSet;
+  typedef llvm::SmallPtrSet<const Expr *, 16> ExprSet;
+  typedef llvm::DenseMap<const VariableDefn *, NewExpr *> AllocMap;
+
+  // Variables being tracked, and the subset of them which escape.
+  VarSet tracked_;
+  VarSet escaped_;
+
+  // Uses of tracked variables which are known not to let them escape.
+  ExprSet safeUses_;
+
+  // For each local variable initialized with a new object, the allocation.
+  AllocMap allocs_;
+
+  EscapeAnalysisPass() {}
+
+  /** Return the variable referred to by 'in', if it is a tracked variable. */
+  const VariableDefn * trackedVar(const Expr * in) const;
+
+  /** Return the tracked variable whose object contains the storage that 'in' refers to,
+      either directly or through embedded structs and arrays. */
+  const VariableDefn * trackedOwner(const Expr * in) const;
+
+  /** Return true if 'fn' can be analyzed at all. */
+  static bool canAnalyze(const FunctionDefn * fn);
+};
+
+} // namespace tart
+
+#endif
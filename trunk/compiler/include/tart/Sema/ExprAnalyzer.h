@@ -121,6 +121,7 @@ public:
   Expr * reduceDoWhileStmt(const DoWhileStmt * st, QualifiedType expected);
   Expr * reduceForStmt(const ForStmt * st, QualifiedType expected);
   Expr * reduceForEachStmt(const ForEachStmt * st, QualifiedType expected);
+  Expr * reduceIndexedForEach(const ForEachStmt * st, Expr * collExpr, LocalScope * forScope);
   Expr * reduceSwitchStmt(const SwitchStmt * st, QualifiedType expected);
   Expr * reduceMatchStmt(const MatchStmt * st, QualifiedType expected);
   Expr * reduceMatchAsStmt(const MatchAsStmt * st, Expr * testExpr, Expr::ExprType castType,
@@ -274,6 +275,9 @@ private:
   /** True if any catch target can catch the specified exception type */
   bool canCatch(TypeList & catchTypes, const CompositeType * exceptionType);
 
+  /** Return true if 'type' is a collection which a for-in loop can iterate by index. */
+  static bool isIndexedCollection(const CompositeType * type);
+
   /** Given an interface (which may be a template), and a concrete type, first locate the method
       in the interface, and then find the overloaded version of that method in the concrete type. */
   FunctionDefn * findInterfaceMethod(const CompositeType * type, const Type * interface,
@@ -24,6 +24,8 @@ namespace tart {
 /// of possible types that can be assigned.
 class Constraint : public GC, public Locatable {
 public:
+  void * operator new(size_t size) { return GC::arenaAlloc(size); }
+
   /** The different kinds of constraints. */
   enum Kind {
     EXACT = 0,          ///< Type must match exactly
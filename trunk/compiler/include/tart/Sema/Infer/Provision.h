@@ -30,6 +30,8 @@ class TypeVariable;
 /// must be met, otherwise the constraint is ignored.
 class Provision : public GC, public Formattable {
 public:
+  void * operator new(size_t size) { return GC::arenaAlloc(size); }
+
   virtual bool isType(uint32_t iid) const = 0;
 
   /** Check whether the provision holds. Returns true if it does. */
@@ -37,6 +37,8 @@ class TypeVariable;
 /// the return type of an overloaded method, for example.
 class TypeAssignment : public Type {
 public:
+  void * operator new(size_t size) { return GC::arenaAlloc(size); }
+
   /** The next type assignment defined in the environment. */
   TypeAssignment * next() const { return next_; }
 
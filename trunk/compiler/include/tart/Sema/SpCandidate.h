@@ -33,6 +33,8 @@ class RelabelTransform;
 /// A candidate for template specialization
 class SpCandidate : public GC {
 public:
+  void * operator new(size_t size) { return GC::arenaAlloc(size); }
+
   SpCandidate(Expr *base, Defn * tdef, const TupleType * args);
 
   /** The definition that has type arguments. */
@@ -29,16 +29,20 @@ namespace {
 
 static bool initialized = false;
 
+static const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+static const size_t ARENA_ALIGNMENT = 8;
+
 // -------------------------------------------------------------------
 // GC
 
 GC * GC::allocList_ = NULL;
+GCArena * GC::arenas_ = NULL;
 GCRootBase * GC::roots_ = NULL;
 GC::CallbackList GC::uninitCallbacks_;
 GC::WeakPtrList GC::weakPtrs_;
 GC::ObjectList GC::toTrace_;
 
-unsigned char GC::cycleIndex_ = 0;
+unsigned char GC::cycleIndex_ = 1;
 
 void * GC::operator new(size_t size) {
   DASSERT(initialized);
@@ -54,6 +58,15 @@ void * GC::operator new(size_t size) {
 
 void GC::operator delete(void * mem) {}
 
+void * GC::arenaAlloc(size_t size) {
+  if (GCArena * arena = GCArena::current_) {
+    DASSERT(initialized);
+    return arena->allocate(size);
+  }
+
+  return GC::operator new(size);
+}
+
 void GC::init() {
   DASSERT(!initialized);
   initialized = true;
@@ -78,8 +91,16 @@ void GC::sweep() {
   reclaimed = 0;
   total = 0;
 
-  // Increment the collection cycle index
-  ++cycleIndex_;
+  // Increment the collection cycle index. Zero is never used as an index, so that it
+  // can mean 'not marked in this round of indices'. When the index wraps around, clear
+  // the marks of arena objects, which may have been unreachable for a long time. Heap
+  // objects need no such care, since every unmarked one is freed by each sweep.
+  if (++cycleIndex_ == 0) {
+    cycleIndex_ = 1;
+    for (GCArena * arena = arenas_; arena != NULL; arena = arena->next_) {
+      arena->clearMarks();
+    }
+  }
 
   // Trace all roots.
   for (GCRootBase * root = roots_; root != NULL; root = root->next_) {
@@ -120,6 +141,17 @@ void GC::sweep() {
     }
   }
 
+  // Free any released arenas which no longer contain reachable objects.
+  GCArena ** arenaPtr = &arenas_;
+  while (GCArena * arena = *arenaPtr) {
+    if (arena->sweep()) {
+      *arenaPtr = arena->next_;
+      delete arena;
+    } else {
+      arenaPtr = &arena->next_;
+    }
+  }
+
   if (debugLevel) {
     diag.info(SourceLocation()) << "GC: " << reclaimed <<
         " objects reclaimed, " << (total - reclaimed) << " in use";
@@ -130,6 +162,96 @@ void GC::setDebugLevel(int level) {
   debugLevel = level;
 }
 
+// -------------------------------------------------------------------
+// GCArena
+
+GCArena * GCArena::current_ = NULL;
+
+struct GCArena::Block {
+  Block * next;
+};
+
+GCArena::GCArena()
+  : blocks_(NULL)
+  , ptr_(NULL)
+  , end_(NULL)
+  , objects_(NULL)
+  , released_(false)
+{
+  next_ = GC::arenas_;
+  GC::arenas_ = this;
+}
+
+GCArena::~GCArena() {
+  while (Block * block = blocks_) {
+    blocks_ = block->next;
+    free(block);
+  }
+}
+
+char * GCArena::addBlock(size_t size) {
+  size_t headerSize = (sizeof(Block) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+  Block * block = reinterpret_cast<Block *>(malloc(headerSize + size));
+  block->next = blocks_;
+  blocks_ = block;
+  return reinterpret_cast<char *>(block) + headerSize;
+}
+
+GC * GCArena::allocate(size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+  char * mem;
+  if (size <= size_t(end_ - ptr_)) {
+    mem = ptr_;
+    ptr_ += size;
+  } else if (size > ARENA_BLOCK_SIZE / 4) {
+    // Large objects get a block of their own, so that the rest of the current
+    // block isn't wasted.
+    mem = addBlock(size);
+  } else {
+    mem = addBlock(ARENA_BLOCK_SIZE);
+    ptr_ = mem + size;
+    end_ = mem + ARENA_BLOCK_SIZE;
+  }
+
+  GC * gc = reinterpret_cast<GC *>(mem);
+  #if GC_DEBUG
+    memset(gc, 0xDB, size);
+  #endif
+  gc->next_ = objects_;
+  gc->cycle_ = GC::cycleIndex_;
+  objects_ = gc;
+  return gc;
+}
+
+void GCArena::clearMarks() {
+  for (GC * gc = objects_; gc != NULL; gc = gc->next_) {
+    gc->cycle_ = 0;
+  }
+}
+
+bool GCArena::sweep() {
+  // An arena which is still in use can't be freed, so there's no need to look at its
+  // objects.
+  if (!released_) {
+    return false;
+  }
+
+  for (GC * gc = objects_; gc != NULL; gc = gc->next_) {
+    if (gc->cycle_ == GC::cycleIndex_) {
+      return false;
+    }
+  }
+
+  for (GC * gc = objects_; gc != NULL;) {
+    GC * next = gc->next_;
+    gc->~GC();
+    gc = next;
+  }
+
+  objects_ = NULL;
+  return true;
+}
+
 // -------------------------------------------------------------------
 // GCRootBase
 
@@ -13,6 +13,7 @@
 #include "tart/Parse/Parser.h"
 
 #include "tart/Meta/MDReader.h"
+#include "tart/Meta/InterfaceFile.h"
 
 #include "tart/Objects/Builtins.h"
 
@@ -137,49 +138,89 @@ bool DirectoryImporter::load(StringRef qualName, Module *& module) {
 // -------------------------------------------------------------------
 // ArchiveImporter
 
-bool ArchiveImporter::load(StringRef qualifiedName, Module *& module) {
-  if (!valid_) {
-    return false;
+ArchiveImporter::~ArchiveImporter() {
+  delete interface_;
+}
+
+bool ArchiveImporter::open() {
+  // The interface file can be mapped into memory and read in place, which is much
+  // faster than parsing the whole library. It is only used if it was written after
+  // the library was last linked.
+  SmallString<128> ifacePath(path_);
+  path::replace_extension(ifacePath, ".tif");
+  bool exists = false;
+  if (fs::exists(Twine(ifacePath), exists) == errc::success && exists &&
+      filetime(ifacePath) >= filetime(path_)) {
+    std::string errorInfo;
+    interface_ = InterfaceFile::open(ifacePath, errorInfo);
+    if (interface_ == NULL) {
+      diag.warn() << "Cannot read interface file " << ifacePath << ": " << errorInfo;
+    } else if (ShowImports) {
+      diag.debug() << "Import: Using interface file " << ifacePath;
+    }
   }
 
-  if (archive_ == NULL) {
+  if (interface_ == NULL) {
     SMDiagnostic smErr;
     archive_ = ParseIRFile(path_.str(), smErr, getGlobalContext());
     if (archive_ == NULL) {
-      bool exists = false;
+      exists = false;
       if (fs::exists(path_.str(), exists) == errc::success && exists) {
         diag.error() << "Cannot load library " << path_;
         diag.info() << smErr.getMessage();
       }
-      valid_ = false;
       return false;
     }
+  }
+
+  archiveSource_ = new ArchiveFile(path_);
+  return true;
+}
+
+bool ArchiveImporter::load(StringRef qualifiedName, Module *& module) {
+  if (!valid_) {
+    return false;
+  }
 
-    archiveSource_ = new ArchiveFile(path_);
+  if (archive_ == NULL && interface_ == NULL && !open()) {
+    valid_ = false;
+    return false;
   }
 
-  Twine mdName("tart.xdef.");
-  NamedMDNode * md = archive_->getNamedMetadata(mdName.concat(qualifiedName));
-  if (md != NULL) {
-    // Convert the qualified name of the module to a relative path.
-    SmallString<128> relpath(path_);
-    relpath.reserve(path_.size() + qualifiedName.size() + 1);
-    relpath.push_back('#');
-    for (size_t i = 0; i < qualifiedName.size(); ++i) {
-      if (qualifiedName[i] == '.') {
-        relpath.push_back('/');
-      } else {
-        relpath.push_back(qualifiedName[i]);
-      }
+  NamedMDNode * md = NULL;
+  uint32_t root = 0;
+  if (interface_ != NULL) {
+    if (!interface_->findModule(qualifiedName, root)) {
+      return false;
+    }
+  } else {
+    Twine mdName("tart.xdef.");
+    md = archive_->getNamedMetadata(mdName.concat(qualifiedName));
+    if (md == NULL) {
+      return false;
+    }
+  }
+
+  // Convert the qualified name of the module to a relative path.
+  SmallString<128> relpath(path_);
+  relpath.reserve(path_.size() + qualifiedName.size() + 1);
+  relpath.push_back('#');
+  for (size_t i = 0; i < qualifiedName.size(); ++i) {
+    if (qualifiedName[i] == '.') {
+      relpath.push_back('/');
+    } else {
+      relpath.push_back(qualifiedName[i]);
     }
+  }
 
-    // Create the module and read the header.
-    module = new Module(qualifiedName, &Builtins::module);
-    module->setModuleSource(new ArchiveEntry(relpath, archiveSource_));
-    return MDReader(module, module).read(md);
+  // Create the module and read the header.
+  module = new Module(qualifiedName, &Builtins::module);
+  module->setModuleSource(new ArchiveEntry(relpath, archiveSource_));
+  if (md == NULL) {
+    return MDReader(module, module).read(NodeRef(interface_, root));
   }
 
-  return false;
+  return MDReader(module, module).read(md);
 }
 
 // -------------------------------------------------------------------
@@ -253,6 +294,39 @@ Module * PackageMgr::loadModule(StringRef qname) {
   return mod;
 }
 
+bool PackageMgr::isModifiedSince(const TimeValue & time) const {
+#if HAVE_STAT
+  for (ModuleMap::const_iterator it = modules_.begin(); it != modules_.end(); ++it) {
+    const Module * mod = it->second;
+    if (mod == NULL || mod->moduleSource() == NULL) {
+      continue;
+    }
+
+    // Modules read from a library are checked against the library file.
+    ProgramSource * source = mod->moduleSource();
+    if (source->container() != NULL) {
+      source = source->container();
+    }
+
+    struct stat st;
+    SmallString<128> pathbuffer(source->filePath());
+    if (stat(pathbuffer.c_str(), &st) != 0) {
+      return true;
+    }
+
+    TimeValue modified(0, 0);
+    modified.fromEpochTime(st.st_mtime);
+    if (modified >= time) {
+      return true;
+    }
+  }
+
+  return false;
+#else
+  #error("Missing implementation for file last modified date.");
+#endif
+}
+
 void PackageMgr::addModule(Module * mod) {
   assert(modules_.find(mod->qualifiedName()) == modules_.end());
   modules_[mod->qualifiedName()] = mod;
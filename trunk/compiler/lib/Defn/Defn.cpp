@@ -25,7 +25,6 @@ Defn::Defn(DefnType dtype, Module * m, StringRef nm)
   , loc(SourceLocation())
   , name_(nm)
   , ast_(NULL)
-  , md_(NULL)
   , storage_(Storage_Global)
   , module_(m)
   , parentDefn_(NULL)
@@ -40,7 +39,6 @@ Defn::Defn(DefnType dtype, Module * m, const ASTDecl * de)
   , loc(de->location())
   , name_(de->name())
   , ast_(de)
-  , md_(NULL)
   , modifiers_(de->modifiers())
   , storage_(Storage_Global)
   , module_(m)
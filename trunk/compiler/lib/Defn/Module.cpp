@@ -35,6 +35,7 @@ Module::Module(StringRef qual, Scope * builtinScope)
   , flags_(Module_Reflect)
   , timestamp_(0, 0)
   , irModule_(NULL)
+  , astArena_(NULL)
 {
   loc.file = NULL;
   setQualifiedName(qual);
@@ -59,6 +60,7 @@ Module::Module(ProgramSource * src, StringRef qual)
   , flags_(Module_Reflect)
   , timestamp_(0, 0)
   , irModule_(NULL)
+  , astArena_(NULL)
 {
   loc.file = src;
   qname_ = qual;
@@ -66,6 +68,14 @@ Module::Module(ProgramSource * src, StringRef qual)
   setScopeName(qual);
 }
 
+Module::~Module() {
+  // Syntax trees can still be referenced from other modules (by template instances,
+  // for example), so they are freed when they are no longer reachable.
+  if (astArena_ != NULL) {
+    astArena_->release();
+  }
+}
+
 void Module::setQualifiedName(StringRef qual) {
   qname_ = qual;
   size_t dot = qual.rfind('.');
@@ -190,6 +200,13 @@ bool Module::lookupMember(StringRef name, DefnList & defs, bool inherit) const {
   return IterableScope::lookupMember(name, defs, inherit);
 }
 
+GCArena * Module::astArena() {
+  if (astArena_ == NULL) {
+    astArena_ = new GCArena();
+  }
+  return astArena_;
+}
+
 llvm::Module * Module::irModule() {
   if (irModule_ == NULL) {
     irModule_ = new llvm::Module(qname_, llvm::getGlobalContext());
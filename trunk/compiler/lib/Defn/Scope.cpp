@@ -46,7 +46,35 @@ void IterableScope::addMember(Defn * d) {
   d->setDefiningScope(this);
 }
 
+void IterableScope::setMemberLoader(MemberLoader * loader) {
+  DASSERT(memberLoader_ == NULL);
+  memberLoader_ = loader;
+}
+
+void IterableScope::finishLoading() {
+  // Lookups by name made while loading still go through the loader. Iterating over
+  // the scope while it is being loaded sees only the members created so far.
+  MemberLoader * loader = memberLoader_;
+  DefnList loaded;
+  loader->setLoadingAll(true);
+  loader->loadAllMembers(loaded);
+  memberLoader_ = NULL;
+  delete loader;
+
+  // Members which were created on demand were added in the order in which they
+  // were looked up. Put them back in declaration order, ahead of anything that was
+  // added to the scope afterwards.
+  members_.moveToFront(loaded);
+}
+
+void IterableScope::clear() {
+  delete memberLoader_;
+  memberLoader_ = NULL;
+  members_.clear();
+}
+
 bool IterableScope::lookupMember(StringRef name, DefnList & defs, bool inherit) const {
+  loadMembers(name);
   const SymbolTable::Entry * entry = members_.findSymbol(name);
   bool found = false;
   if (entry != NULL) {
@@ -5,6 +5,8 @@
 #include "tart/Defn/Defn.h"
 #include "tart/Defn/SymbolTable.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+
 namespace tart {
 
 SymbolTable::Entry * SymbolTable::add(Defn * member) {
@@ -60,4 +62,27 @@ SymbolTable::Entry * OrderedSymbolTable::add(Defn * member) {
   return result;
 }
 
+void OrderedSymbolTable::moveToFront(const DefnList & leading) {
+  llvm::SmallPtrSet<Defn *, 32> moved(leading.begin(), leading.end());
+  DefnList order(leading.begin(), leading.end());
+  for (Defn * de = first_; de != NULL; de = de->nextInScope_) {
+    if (!moved.count(de)) {
+      order.push_back(de);
+    }
+  }
+
+  first_ = last_ = NULL;
+  for (DefnList::const_iterator it = order.begin(); it != order.end(); ++it) {
+    Defn * de = *it;
+    de->nextInScope_ = NULL;
+    if (last_ != NULL) {
+      last_->nextInScope_ = de;
+    } else {
+      first_ = de;
+    }
+
+    last_ = de;
+  }
+}
+
 }
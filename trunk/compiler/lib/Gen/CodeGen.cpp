@@ -60,6 +60,10 @@ NoGC("nogc", llvm::cl::desc("Don't generate garbage-collection intrinsics"));
 llvm::cl::opt<bool>
 SsGC("ssgc", llvm::cl::desc("Don't generate garbage-collection intrinsics"));
 
+llvm::cl::opt<bool>
+InlineCaches("inline-caches",
+    llvm::cl::desc("Cache the targets of interface method calls at each call site"));
+
 extern SystemNamespaceMember<FunctionDefn> gc_alloc;
 
 CodeGenerator::CodeGenerator(Module * mod)
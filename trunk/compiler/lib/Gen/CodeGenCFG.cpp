@@ -24,9 +24,77 @@
 #include "llvm/Intrinsics.h"
 #include "llvm/Module.h"
 
+#include <map>
+
 namespace tart {
 using namespace llvm;
 
+SystemClassMember<FunctionDefn> string_computeHash(Builtins::typeString, "computeHash");
+
+namespace {
+
+// Switches on strings with at least this many case values are dispatched on the hash of
+// the string, rather than by comparing against each case value in turn.
+const size_t HASH_SWITCH_MIN_CASES = 6;
+
+/// Read an integer of 'size' bytes in the target's byte order.
+uint64_t readWord(const unsigned char * p, size_t size, bool littleEndian) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < size; ++i) {
+    size_t shift = littleEndian ? i * 8 : (size - 1 - i) * 8;
+    result |= uint64_t(p[i]) << shift;
+  }
+
+  return result;
+}
+
+/// Compute the hash of a string at compile time. This must produce the same result as
+/// String.computeHash(), which hashes the string's bytes with Hashing.murmurHash(), reading
+/// them a word at a time in the target's byte order.
+uint64_t stringHash(StringRef str, bool littleEndian) {
+  const uint64_t M64 = 0xc6a4a7935bd1e995ULL;
+  const int R = 47;
+  const unsigned char * data = reinterpret_cast<const unsigned char *>(str.data());
+  size_t len = str.size();
+
+  uint64_t h = uint64_t(len) * M64;
+  size_t pos = 0;
+  for (; pos + 8 <= len; pos += 8) {
+    uint64_t k = readWord(data + pos, 8, littleEndian);
+    k *= M64;
+    k ^= k >> R;
+    k *= M64;
+
+    h ^= k;
+    h *= M64;
+  }
+
+  if ((len & 7) != 0) {
+    if ((len & 4) != 0) {
+      h ^= readWord(data + pos, 4, littleEndian) << 32;
+      pos += 4;
+    }
+
+    if ((len & 2) != 0) {
+      h ^= readWord(data + pos, 2, littleEndian) << 16;
+      pos += 2;
+    }
+
+    if ((len & 1) != 0) {
+      h ^= uint64_t(data[pos]) << 8;
+    }
+
+    h *= M64;
+  }
+
+  h ^= h >> R;
+  h *= M64;
+  h ^= h >> R;
+  return h;
+}
+
+}
+
 void CodeGenerator::genLocalStorage(LocalScopeList & lsl) {
   for (LocalScopeList::iterator it = lsl.begin(); it != lsl.end(); ++it) {
     LocalScope * lscope = *it;
@@ -47,7 +115,8 @@ void CodeGenerator::genLocalRoots(LocalScopeList & lsl) {
       if (VariableDefn * var = dyn_cast<VariableDefn>(de)) {
         if (var->isSharedRef()) {
           genGCRoot(var->irValue(), var->sharedRefType(), var->name());
-        } else if (var->hasStorage() && var->type()->containsReferenceType()) {
+        } else if (var->hasStorage() && var->type()->containsReferenceType() &&
+            !var->isStackObject()) {
           genGCRoot(var->irValue(), var->type().unqualified(), var->name());
         }
       }
@@ -70,8 +139,7 @@ void CodeGenerator::genLocalVar(VariableDefn * var, Value * initialVal) {
     DASSERT_OBJ(cellType != NULL, var);
     llvm::Type * irType = cellType->irEmbeddedType();
 
-    Value * cellValue = builder_.CreateCall2(
-            getGcAlloc(), gcAllocContext_,
+    Value * cellValue = genGcAlloc(
             llvm::ConstantExpr::getIntegerCast(
                 llvm::ConstantExpr::getSizeOf(cellType->irTypeComplete()), intPtrType_, false),
             var->name() + StringRef(".shared.alloc"));
@@ -412,6 +480,20 @@ Value * CodeGenerator::genSwitch(const SwitchExpr * in) {
   if (testType->isIntType() || testType.isa<EnumType>()) {
     return genIntegerSwitch(in);
   } else if (testType == Builtins::typeString.get()) {
+    size_t numCases = 0;
+    bool allConstant = true;
+    for (SwitchExpr::const_iterator it = in->begin(); it != in->end(); ++it) {
+      const CaseExpr * ce = cast<CaseExpr>(*it);
+      numCases += ce->argCount();
+      for (CaseExpr::const_iterator vi = ce->begin(); vi != ce->end(); ++vi) {
+        allConstant &= isa<ConstantString>(*vi);
+      }
+    }
+
+    if (allConstant && numCases >= HASH_SWITCH_MIN_CASES) {
+      return genHashSwitch(in);
+    }
+
     return genEqSwitch(in);
   } else {
     DFAIL("Bad switch type");
@@ -560,37 +642,125 @@ Value * CodeGenerator::genEqSwitch(const SwitchExpr * in) {
     // Generate the case body.
     moveToEnd(blkCase);
     builder_.SetInsertPoint(blkCase);
-    Value * result = genExpr(ce->body());
-
-    // Jump to the 'done' body.
-    if (!atTerminator()) {
-      blkDone = ensureBlock("switch.end", blkDone);
-      builder_.CreateBr(blkDone);
-
-      // Add to phi
-      if (phi != NULL) {
-        phi->addIncoming(result, builder_.GetInsertBlock());
-      }
-    }
+    genCaseBody(ce->body(), phi, blkDone);
 
     moveToEnd(blkNext);
     builder_.SetInsertPoint(blkNext);
   }
 
   if (hasElse) {
-    blkNext = ensureBlock("switch.else", blkNext);
-    builder_.SetInsertPoint(blkNext);
-    Value * result = genExpr(in->elseCase());
+    builder_.SetInsertPoint(ensureBlock("switch.else", blkNext));
+  }
 
-    if (!atTerminator()) {
-      blkDone = ensureBlock("switch.end", blkDone);
-      builder_.CreateBr(blkDone);
+  return genSwitchEnd(in, phi, blkDone, savedRootCount);
+}
 
-      // Add to phi
-      if (phi != NULL) {
-        phi->addIncoming(result, builder_.GetInsertBlock());
+Value * CodeGenerator::genHashSwitch(const SwitchExpr * in) {
+  size_t savedRootCount = rootStackSize();
+  Value * switchValue = genExpr(in->value());
+  if (switchValue == NULL) {
+    return NULL;
+  }
+
+  bool hasElse = in->elseCase() != NULL;
+  BasicBlock * blkDone = NULL;
+  BasicBlock * blkDefault = createBlock(hasElse ? "switch.else" : "switch.default");
+
+  // Create the PHI node if return type is not void.
+  PHINode * phi = NULL;
+  if (!in->type()->isVoidType()) {
+    phi = PHINode::Create(in->type()->irType(), in->argCount());
+  }
+
+  Function * eqTestFn = genFunctionValue(in->equalityTestFn());
+  Function * hashFn = genFunctionValue(string_computeHash);
+  bool littleEndian = targetData_->isLittleEndian();
+
+  // A null string can't match any of the cases.
+  BasicBlock * blkHash = createBlock("switch.hash");
+  builder_.CreateCondBr(
+      builder_.CreateIsNull(switchValue, "switch.isnull"), blkDefault, blkHash);
+
+  // Dispatch on the hash of the string.
+  builder_.SetInsertPoint(blkHash);
+  ValueList hashArgs;
+  hashArgs.push_back(switchValue);
+  Value * hashValue = genCallInstr(hashFn, hashArgs, "switch.hashval");
+  SwitchInst * switchInst = builder_.CreateSwitch(hashValue, blkDefault);
+
+  // Group the case values by hash, in case two of them collide. Each group gets a block
+  // which confirms the match by comparing the strings.
+  typedef std::pair<Constant *, BasicBlock *> CaseTarget;
+  typedef std::map<uint64_t, llvm::SmallVector<CaseTarget, 1> > HashGroupMap;
+  HashGroupMap groups;
+  llvm::SmallVector<uint64_t, 16> hashOrder;
+  llvm::SmallVector<BasicBlock *, 16> caseBlocks;
+  for (SwitchExpr::const_iterator it = in->begin(); it != in->end(); ++it) {
+    CaseExpr * ce = cast<CaseExpr>(*it);
+    BasicBlock * blkCase = createBlock("case");
+    caseBlocks.push_back(blkCase);
+    for (CaseExpr::const_iterator vi = ce->begin(); vi != ce->end(); ++vi) {
+      ConstantString * strVal = cast<ConstantString>(*vi);
+      uint64_t hash = stringHash(strVal->value(), littleEndian);
+      if (groups.count(hash) == 0) {
+        hashOrder.push_back(hash);
       }
+      groups[hash].push_back(CaseTarget(genConstExpr(strVal), blkCase));
     }
+  }
+
+  for (llvm::SmallVectorImpl<uint64_t>::iterator it = hashOrder.begin();
+      it != hashOrder.end(); ++it) {
+    BasicBlock * blkTest = createBlock("case.test");
+    switchInst->addCase(
+        cast<ConstantInt>(ConstantInt::get(hashValue->getType(), *it)), blkTest);
+    builder_.SetInsertPoint(blkTest);
+    const llvm::SmallVector<CaseTarget, 1> & targets = groups[*it];
+    for (size_t i = 0; i < targets.size(); ++i) {
+      BasicBlock * blkNext = i + 1 < targets.size() ? createBlock("case.test") : blkDefault;
+      ValueList args;
+      args.push_back(switchValue);
+      args.push_back(targets[i].first);
+      Value * testResult = genCallInstr(eqTestFn, args, "case.eq");
+      builder_.CreateCondBr(testResult, targets[i].second, blkNext);
+      builder_.SetInsertPoint(blkNext);
+    }
+  }
+
+  // Generate the case bodies.
+  size_t caseIndex = 0;
+  for (SwitchExpr::const_iterator it = in->begin(); it != in->end(); ++it, ++caseIndex) {
+    CaseExpr * ce = cast<CaseExpr>(*it);
+    BasicBlock * blkCase = caseBlocks[caseIndex];
+    moveToEnd(blkCase);
+    builder_.SetInsertPoint(blkCase);
+    genCaseBody(ce->body(), phi, blkDone);
+  }
+
+  moveToEnd(blkDefault);
+  builder_.SetInsertPoint(blkDefault);
+  return genSwitchEnd(in, phi, blkDone, savedRootCount);
+}
+
+void CodeGenerator::genCaseBody(const Expr * body, PHINode * phi, BasicBlock *& blkDone) {
+  Value * result = genExpr(body);
+
+  // Jump to the 'done' body.
+  if (!atTerminator()) {
+    blkDone = ensureBlock("switch.end", blkDone);
+    builder_.CreateBr(blkDone);
+
+    // Add to phi
+    if (phi != NULL) {
+      phi->addIncoming(result, builder_.GetInsertBlock());
+    }
+  }
+}
+
+Value * CodeGenerator::genSwitchEnd(const SwitchExpr * in, PHINode * phi, BasicBlock * blkDone,
+    size_t savedRootCount) {
+  if (in->elseCase() != NULL) {
+    genCaseBody(in->elseCase(), phi, blkDone);
   } else {
     // A switch statement that returns a value must have an 'else' clause.
     if (phi != NULL) {
@@ -896,8 +1066,8 @@ Value * CodeGenerator::genTry(const TryExpr * in) {
           VariableDefn * catchVar = ce->var();
           if (catchVar != NULL) {
             const CompositeType * exceptType = cast<CompositeType>(catchVar->type().unqualified());
-            Twine name = Twine("try.catch.") + exceptType->typeDefn()->qualifiedName();
-            BasicBlock * blkCatchBody = createBlock(name);
+            BasicBlock * blkCatchBody =
+                createBlock(Twine("try.catch.") + exceptType->typeDefn()->qualifiedName());
             si->addCase(getInt32Val(selectorIndex++), blkCatchBody);
             builder_.SetInsertPoint(blkCatchBody);
             setDebugLocation(ce->location());
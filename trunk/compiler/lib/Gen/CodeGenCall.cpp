@@ -4,6 +4,7 @@
 
 #include "tart/Defn/TypeDefn.h"
 #include "tart/Defn/FunctionDefn.h"
+#include "tart/Defn/VariableDefn.h"
 
 #include "tart/Expr/Exprs.h"
 
@@ -18,11 +19,22 @@
 #include "tart/Objects/SystemDefs.h"
 
 #include "llvm/Function.h"
+#include "llvm/Support/CommandLine.h"
 
 namespace tart {
 
 using namespace llvm;
 
+extern llvm::cl::opt<bool> InlineCaches;
+
+// Number of (TIB, method) pairs in the inline cache of an interface call site. Must match
+// the runtime's InlineCache_fill.
+static const int INLINE_CACHE_ENTRIES = 2;
+
+SystemClassMember<VariableDefn> allocContext_top(Builtins::typeAllocContext, "top");
+SystemClassMember<VariableDefn> allocContext_limit(Builtins::typeAllocContext, "limit");
+SystemClassMember<VariableDefn> object_gcstate(Builtins::typeObject, "__gcstate");
+
 Value * CodeGenerator::genCall(const tart::FnCallExpr* in) {
   const FunctionDefn * fn = in->function();
   const FunctionType * fnType = fn->functionType();
@@ -187,8 +199,8 @@ Value * CodeGenerator::genVTableLookup(const FunctionDefn * method, const Compos
   indices.push_back(getInt32Val(0));
 
   // Get the TIB
-  Twine tibName = Twine("tib.") + classType->typeDefn()->name();
-  Twine tibAddrName = Twine("tibaddr.") + classType->typeDefn()->name();
+  std::string tibName = (Twine("tib.") + classType->typeDefn()->name()).str();
+  std::string tibAddrName = (Twine("tibaddr.") + classType->typeDefn()->name()).str();
   Value * tib = builder_.CreateLoad(
       builder_.CreateInBoundsGEP(selfPtr, indices, tibAddrName), tibName);
 
@@ -196,11 +208,20 @@ Value * CodeGenerator::genVTableLookup(const FunctionDefn * method, const Compos
   indices.push_back(getInt32Val(0));
   indices.push_back(getInt32Val(TIB_METHOD_TABLE));
   indices.push_back(getInt32Val(methodIndex));
-  Twine methodName = Twine("method.") + method->name();
-  Twine methodPtrName = Twine("method.ptr.") + method->name();
+  std::string methodName = (Twine("method.") + method->name()).str();
+  std::string methodPtrName = (Twine("method.ptr.") + method->name()).str();
   Value * fptr = builder_.CreateLoad(
       builder_.CreateInBoundsGEP(tib, indices), methodPtrName);
-  return builder_.CreateBitCast(fptr, method->type()->irType()->getPointerTo(), methodName);
+  Value * result =
+      builder_.CreateBitCast(fptr, method->type()->irType()->getPointerTo(), methodName);
+
+  // Tell the linker's devirtualization pass which method this is.
+  Value * devirtInfo[2] = {
+    MDString::get(context_, classType->typeDefn()->linkageName() + ".TIB"),
+    getInt32Val(methodIndex),
+  };
+  cast<Instruction>(result)->setMetadata("tart.vcall", MDNode::get(context_, devirtInfo));
+  return result;
 }
 
 Value * CodeGenerator::genITableLookup(const FunctionDefn * method, const CompositeType * classType,
@@ -225,15 +246,88 @@ Value * CodeGenerator::genITableLookup(const FunctionDefn * method, const Compos
 
   // Load the pointer to the TIB.
   objectPtr = builder_.CreatePointerCast(objectPtr, Builtins::typeObject->irEmbeddedType());
-  Twine tibName = Twine("tib.") + classType->typeDefn()->name();
-  Twine tibAddrName = Twine("tibaddr.") + classType->typeDefn()->name();
+  std::string tibName = (Twine("tib.") + classType->typeDefn()->name()).str();
+  std::string tibAddrName = (Twine("tibaddr.") + classType->typeDefn()->name()).str();
   Value * tib = builder_.CreateLoad(
       builder_.CreateConstInBoundsGEP2_32(objectPtr, 0, 0, tibAddrName),
       tibName);
 
+  // With inline caches enabled, check whether this call site has already seen the type
+  // of the receiver. Entries are filled at most once, by the runtime, which publishes the
+  // method before the TIB; so reading the TIB with acquire ordering makes the method valid.
+  StringRef ifName = classType->typeDefn()->name();
+  Value * devirtInfo[3] = {
+    MDString::get(context_, classType->typeDefn()->linkageName() + ".TIB"),
+    iname,
+    getInt32Val(methodIndex),
+  };
+  MDNode * devirtNode = MDNode::get(context_, devirtInfo);
+  std::string methodName = (Twine("method.") + method->name()).str();
+  std::string methodPtrName = (Twine("method.ptr.") + method->name()).str();
+  GlobalVariable * cache = NULL;
+  Value * tibKey = NULL;
+  BasicBlock * blkCached = NULL;
+  SmallVector<std::pair<Value *, BasicBlock *>, INLINE_CACHE_ENTRIES> cachedPtrs;
+  if (InlineCaches) {
+    ArrayType * cacheType = ArrayType::get(methodPtrType_, INLINE_CACHE_ENTRIES * 2);
+    cache = new GlobalVariable(*irModule_, cacheType, false, GlobalValue::InternalLinkage,
+        ConstantAggregateZero::get(cacheType), Twine("icache.") + ifName);
+    tibKey = builder_.CreatePointerCast(tib, methodPtrType_);
+    blkCached = BasicBlock::Create(context_, "icache.done", currentFn_);
+    for (int i = 0; i < INLINE_CACHE_ENTRIES; ++i) {
+      LoadInst * entryTib = builder_.CreateLoad(
+          builder_.CreateConstInBoundsGEP2_32(cache, 0, i * 2), "icache.tib");
+      entryTib->setAlignment(targetData_->getPointerABIAlignment());
+      entryTib->setAtomic(Acquire);
+      BasicBlock * blkEntryHit = BasicBlock::Create(context_, "icache.hit", currentFn_);
+      BasicBlock * blkNext = BasicBlock::Create(context_, "icache.miss", currentFn_);
+      Value * cacheHit = builder_.CreateICmpEQ(entryTib, tibKey);
+      cast<Instruction>(cacheHit)->setMetadata("tart.icall.guard", devirtNode);
+      builder_.CreateCondBr(cacheHit, blkEntryHit, blkNext);
+
+      builder_.SetInsertPoint(blkEntryHit);
+      Value * entryMethod = builder_.CreateLoad(
+          builder_.CreateConstInBoundsGEP2_32(cache, 0, i * 2 + 1), methodPtrName);
+      cachedPtrs.push_back(std::make_pair(entryMethod, blkEntryHit));
+      builder_.CreateBr(blkCached);
+      builder_.SetInsertPoint(blkNext);
+    }
+  }
+
+  // Look in the slot of the type's interface table where the interface would be placed.
+  // Interfaces which were left out of the table because of a collision, or which the type
+  // does not implement, are handled by the dispatcher function.
+  Value * itable = builder_.CreateLoad(
+      builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_ITABLE), Twine("itable.") + ifName);
+  Value * itableMask = builder_.CreateLoad(
+      builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_ITABLE_MASK),
+      Twine("itable.mask.") + ifName);
+  Value * slot = builder_.CreateShl(
+      builder_.CreateAnd(getInt32Val(interfaceHash(classType)), itableMask), 1, "itable.slot");
+  Value * slotIid = builder_.CreateLoad(builder_.CreateInBoundsGEP(itable, slot), "itable.iid");
+  Value * found = builder_.CreateICmpEQ(slotIid,
+      llvm::ConstantExpr::getBitCast(iname, slotIid->getType()), "itable.found");
+  cast<Instruction>(found)->setMetadata("tart.icall.guard", devirtNode);
+
+  BasicBlock * blkHit = BasicBlock::Create(context_, "itable.hit", currentFn_);
+  BasicBlock * blkMiss = BasicBlock::Create(context_, "itable.miss", currentFn_);
+  BasicBlock * blkDone = BasicBlock::Create(context_, "itable.done", currentFn_);
+  builder_.CreateCondBr(found, blkHit, blkMiss);
+
+  // Load the method directly from the interface's method table.
+  builder_.SetInsertPoint(blkHit);
+  Value * methods = builder_.CreateLoad(
+      builder_.CreateInBoundsGEP(itable, builder_.CreateAdd(slot, getInt32Val(1))),
+      "itable.methods");
+  methods = builder_.CreateBitCast(methods, methodPtrType_->getPointerTo());
+  Value * fastPtr = builder_.CreateLoad(
+      builder_.CreateConstInBoundsGEP1_32(methods, methodIndex), methodPtrName);
+  builder_.CreateBr(blkDone);
+
   // Load the pointer to the dispatcher function.
-  Twine idispName = Twine("idispatch.") + classType->typeDefn()->name();
-  Twine idispAddrName = Twine("idispatchaddr.") + classType->typeDefn()->name();
+  builder_.SetInsertPoint(blkMiss);
+  std::string idispName = (Twine("idispatch.") + ifName).str();
+  std::string idispAddrName = (Twine("idispatchaddr.") + ifName).str();
   Value * dispatcher = builder_.CreateLoad(
       builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_IDISPATCH, idispAddrName), idispName);
 
@@ -241,10 +335,57 @@ Value * CodeGenerator::genITableLookup(const FunctionDefn * method, const Compos
   ValueList args;
   args.push_back(iname);
   args.push_back(getInt32Val(methodIndex));
-  Twine methodName = Twine("method.") + method->name();
-  Twine methodPtrName = Twine("method.ptr.") + method->name();
-  Value * methodPtr = genCallInstr(dispatcher, args, methodPtrName);
-  return builder_.CreateBitCast(methodPtr, method->type()->irType()->getPointerTo(), methodName);
+  Value * slowPtr = builder_.CreatePointerCast(
+      genCallInstr(dispatcher, args, methodPtrName), methodPtrType_);
+  blkMiss = builder_.GetInsertBlock();
+  builder_.CreateBr(blkDone);
+
+  builder_.SetInsertPoint(blkDone);
+  PHINode * methodPtr = builder_.CreatePHI(methodPtrType_, 2, methodPtrName);
+  methodPtr->addIncoming(fastPtr, blkHit);
+  methodPtr->addIncoming(slowPtr, blkMiss);
+
+  if (cache != NULL) {
+    // Record the receiver type and method in the cache, if there is room. Entries are
+    // claimed in order, so once the last one has a method the cache is full; checking
+    // that inline keeps a megamorphic call site from calling into the runtime every time.
+    LoadInst * lastMethod = builder_.CreateLoad(
+        builder_.CreateConstInBoundsGEP2_32(cache, 0, INLINE_CACHE_ENTRIES * 2 - 1),
+        "icache.last");
+    lastMethod->setAlignment(targetData_->getPointerABIAlignment());
+    lastMethod->setAtomic(Monotonic);
+    BasicBlock * blkFill = BasicBlock::Create(context_, "icache.fill", currentFn_);
+    builder_.CreateCondBr(builder_.CreateIsNull(lastMethod, "icache.room"), blkFill, blkCached);
+
+    builder_.SetInsertPoint(blkFill);
+    llvm::Type * bytePtrType = builder_.getInt8PtrTy();
+    Constant * fillFn = irModule_->getOrInsertFunction("InlineCache_fill",
+        builder_.getVoidTy(), bytePtrType, bytePtrType, bytePtrType, NULL);
+    builder_.CreateCall3(fillFn,
+        builder_.CreatePointerCast(cache, bytePtrType), tibKey, methodPtr);
+    builder_.CreateBr(blkCached);
+
+    // Move the join block after the lookup, so the blocks are in a sensible order.
+    blkFill->moveAfter(blkDone);
+    blkCached->moveAfter(blkFill);
+    builder_.SetInsertPoint(blkCached);
+    PHINode * cachedPtr = builder_.CreatePHI(
+        methodPtrType_, INLINE_CACHE_ENTRIES + 2, Twine("method.cached.") + method->name());
+    for (size_t i = 0; i < cachedPtrs.size(); ++i) {
+      cachedPtr->addIncoming(cachedPtrs[i].first, cachedPtrs[i].second);
+    }
+
+    cachedPtr->addIncoming(methodPtr, blkDone);
+    cachedPtr->addIncoming(methodPtr, blkFill);
+    methodPtr = cachedPtr;
+  }
+
+  // Tell the linker's devirtualization pass which method this is, and which branches can be
+  // made unconditional if the method turns out to have a single implementation.
+  Value * result =
+      builder_.CreateBitCast(methodPtr, method->type()->irType()->getPointerTo(), methodName);
+  cast<Instruction>(result)->setMetadata("tart.icall", devirtNode);
+  return result;
 }
 
 Value * CodeGenerator::genBoundMethod(const BoundMethodExpr * in) {
@@ -310,10 +451,11 @@ Value * CodeGenerator::genNew(const tart::NewExpr* in) {
       }
       return builder_.CreateAlloca(type, 0, ctdef->typeDefn()->name());
     } else if (ctdef->typeClass() == Type::Class) {
-      DASSERT(gcAllocContext_ != NULL);
-      Function * alloc = getGcAlloc();
-      Value * newObj = builder_.CreateCall2(
-          alloc, gcAllocContext_,
+      if (in->isStackAlloc()) {
+        return genStackAlloc(ctdef);
+      }
+
+      Value * newObj = genGcAlloc(
           llvm::ConstantExpr::getIntegerCast(
               llvm::ConstantExpr::getSizeOf(type),
               intPtrType_, false),
@@ -327,15 +469,95 @@ Value * CodeGenerator::genNew(const tart::NewExpr* in) {
   DFAIL("IllegalState");
 }
 
+Value * CodeGenerator::genStackAlloc(const CompositeType * ctdef) {
+  llvm::Type * type = ctdef->irTypeComplete();
+
+  // Add an alloca to the prologue block. Since the object isn't in the heap, the collector
+  // ignores references to it; instead the object is itself a root, so that the objects
+  // which its fields refer to are traced.
+  IRBuilderBase::InsertPoint savePt = builder_.saveIP();
+  builder_.SetInsertPoint(&currentFn_->getBasicBlockList().front());
+  Value * newObj = builder_.CreateAlloca(type, NULL, Twine(ctdef->typeDefn()->name(), "_stack"));
+  if (gcEnabled_) {
+    if (llvm::Constant * traceTable = getTraceTable(ctdef)) {
+      // Roots with metadata aren't cleared by the collector strategy, and a collection
+      // may happen before the allocation is reached, so clear the object here too.
+      markGCRoot(newObj, traceTable, newObj->getName());
+      initGCRoot(newObj);
+    }
+  }
+
+  builder_.restoreIP(savePt);
+
+  // Objects from the heap are zero-filled, and if the allocation is inside of a loop
+  // the previous instance must be cleared.
+  builder_.CreateStore(ConstantAggregateZero::get(type), newObj);
+  genInitObjVTable(ctdef, newObj);
+  return newObj;
+}
+
 Value * CodeGenerator::defaultAlloc(const tart::Expr * size) {
-  DASSERT(gcAllocContext_ != NULL);
   Value * sizeVal = genExpr(size);
-  Function * alloc = getGcAlloc();
   return builder_.CreatePointerCast(
-      builder_.CreateCall2(alloc, gcAllocContext_, sizeVal, "newInstance"),
+      genGcAlloc(sizeVal, "newInstance"),
       builder_.getInt8PtrTy());
 }
 
+Value * CodeGenerator::genGcAlloc(Value * size, const Twine & name) {
+  DASSERT(gcAllocContext_ != NULL);
+  Function * alloc = getGcAlloc();
+  llvm::Type * sizeType = alloc->getFunctionType()->getParamType(1);
+
+  // Sizes are rounded up to a multiple of 8, the same as the collector does.
+  size = builder_.CreateIntCast(size, intPtrType_, false);
+  size = builder_.CreateAnd(
+      builder_.CreateAdd(size, llvm::ConstantInt::get(intPtrType_, 7)),
+      llvm::ConstantInt::get(intPtrType_, ~uint64_t(7)), "allocSize");
+
+  // Bump the top of the allocation buffer, if there is room.
+  Value * ctx = builder_.CreatePointerCast(
+      gcAllocContext_, Builtins::typeAllocContext->irTypeComplete()->getPointerTo());
+  Value * topPtr = builder_.CreateStructGEP(ctx, allocContext_top->memberIndex(), "alloc.topPtr");
+  Value * top = builder_.CreateLoad(topPtr, "alloc.top");
+  Value * limit = builder_.CreateLoad(
+      builder_.CreateStructGEP(ctx, allocContext_limit->memberIndex()), "alloc.limit");
+  // 'top' is null until the buffer has been filled, so this must not be an inbounds GEP:
+  // one off a null pointer is poison, and the optimizer could fold the limit check.
+  Value * newTop = builder_.CreateGEP(top, size, "alloc.newTop");
+
+  BasicBlock * blkFast = BasicBlock::Create(context_, "alloc.fast", currentFn_);
+  BasicBlock * blkSlow = BasicBlock::Create(context_, "alloc.slow", currentFn_);
+  BasicBlock * blkDone = BasicBlock::Create(context_, "alloc.done", currentFn_);
+  blkFast->moveAfter(builder_.GetInsertBlock());
+  blkDone->moveAfter(blkFast);
+  builder_.CreateCondBr(builder_.CreateICmpULE(newTop, limit), blkFast, blkSlow);
+
+  // Fast path: the collector expects the object's size in its gcstate field.
+  builder_.SetInsertPoint(blkFast);
+  builder_.CreateStore(newTop, topPtr);
+  Value * fastObj = builder_.CreatePointerCast(top, alloc->getReturnType());
+  Value * gcstatePtr = builder_.CreateStructGEP(
+      builder_.CreatePointerCast(top, Builtins::typeObject.irType()->getPointerTo()),
+      object_gcstate->memberIndex());
+  builder_.CreateStore(
+      builder_.CreateIntCast(size, cast<PointerType>(gcstatePtr->getType())->getElementType(),
+          false),
+      gcstatePtr);
+  builder_.CreateBr(blkDone);
+
+  // Slow path: let the collector refill the buffer.
+  builder_.SetInsertPoint(blkSlow);
+  Value * slowObj = builder_.CreateCall2(alloc, gcAllocContext_,
+      builder_.CreateIntCast(size, sizeType, false));
+  builder_.CreateBr(blkDone);
+
+  builder_.SetInsertPoint(blkDone);
+  PHINode * result = builder_.CreatePHI(alloc->getReturnType(), 2, name);
+  result->addIncoming(fastObj, blkFast);
+  result->addIncoming(slowObj, blkSlow);
+  return result;
+}
+
 Value * CodeGenerator::genCallInstr(Value * func, ArrayRef<Value *> args, const Twine & name) {
   checkCallingArgs(func, args);
   if (isUnwindBlock_) {
@@ -487,11 +487,75 @@ Value * CodeGenerator::genCompositeTypeTest(Value * val, const CompositeType * t
   // Upcast to type 'object' and load the TIB pointer.
   Value * tib = builder_.CreateLoad(builder_.CreateStructGEP(valueAsObjType, 0, "tib.addr"), "tib");
 
+  // The test may be generated inside a cast-checking function, so currentFn_ is not used.
+  BasicBlock * blkEntry = builder_.GetInsertBlock();
+  Function * fn = blkEntry->getParent();
+  BasicBlock * blkDone = BasicBlock::Create(context_, "isa.done", fn);
+  PHINode * result;
+
+  if (toType->typeClass() == Type::Class) {
+    // A class at depth N is in the display of every subclass, at index N.
+    int32_t depth = classDepth(toType);
+    BasicBlock * blkTest = BasicBlock::Create(context_, "isa.display", fn);
+    Value * tibDepth = builder_.CreateLoad(
+        builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_DEPTH), "tib.depth");
+    builder_.CreateCondBr(
+        builder_.CreateICmpSGE(tibDepth, getInt32Val(depth)), blkTest, blkDone);
+
+    builder_.SetInsertPoint(blkTest);
+    Value * display = builder_.CreateLoad(
+        builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_DISPLAY), "tib.display");
+    Value * entry = builder_.CreateLoad(
+        builder_.CreateConstInBoundsGEP1_32(display, depth), "tib.display.entry");
+    Value * found = builder_.CreateICmpEQ(entry,
+        llvm::ConstantExpr::getPointerCast(toTypeObj, entry->getType()));
+    builder_.CreateBr(blkDone);
+
+    builder_.SetInsertPoint(blkDone);
+    result = builder_.CreatePHI(builder_.getInt1Ty(), 2,
+        Twine("isa.") + toType->typeDefn()->name());
+    result->addIncoming(builder_.getFalse(), blkEntry);
+    result->addIncoming(found, blkTest);
+    return result;
+  }
+
+  // For an interface, rule out types whose interface bits don't include it, then look for it
+  // in the slot of the itable where it would be placed. Only if both tests are inconclusive
+  // do we need to search the list of bases.
+  BasicBlock * blkITable = BasicBlock::Create(context_, "isa.itable", fn);
+  BasicBlock * blkSearch = BasicBlock::Create(context_, "isa.search", fn);
+  Value * bits = builder_.CreateLoad(
+      builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_INTERFACE_BITS), "tib.ibits");
+  Value * maybe = builder_.CreateICmpNE(
+      builder_.CreateAnd(bits, getInt64Val(interfaceBit(toType))), getInt64Val(0));
+  builder_.CreateCondBr(maybe, blkITable, blkDone);
+
+  builder_.SetInsertPoint(blkITable);
+  Value * itable = builder_.CreateLoad(
+      builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_ITABLE), "itable");
+  Value * itableMask = builder_.CreateLoad(
+      builder_.CreateConstInBoundsGEP2_32(tib, 0, TIB_ITABLE_MASK), "itable.mask");
+  Value * slot = builder_.CreateShl(
+      builder_.CreateAnd(getInt32Val(interfaceHash(toType)), itableMask), 1, "itable.slot");
+  Value * slotIid = builder_.CreateLoad(builder_.CreateInBoundsGEP(itable, slot), "itable.iid");
+  Constant * iname = reflector_.internSymbol(toType->typeDefn()->linkageName());
+  Value * found = builder_.CreateICmpEQ(slotIid,
+      llvm::ConstantExpr::getBitCast(iname, slotIid->getType()));
+  builder_.CreateCondBr(found, blkDone, blkSearch);
+
+  builder_.SetInsertPoint(blkSearch);
   Value * args[2] = { tib, toTypeObj };
   Function * upcastTest = genFunctionValue(Builtins::funcHasBase);
   checkCallingArgs(upcastTest, args);
-  Value * result = builder_.CreateCall(upcastTest, args,
+  Value * searchResult = builder_.CreateCall(upcastTest, args);
+  builder_.CreateBr(blkDone);
+
+  builder_.SetInsertPoint(blkDone);
+  result = builder_.CreatePHI(builder_.getInt1Ty(), 3,
       Twine("isa.") + toType->typeDefn()->name());
+  result->addIncoming(builder_.getFalse(), blkEntry);
+  result->addIncoming(builder_.getTrue(), blkITable);
+  result->addIncoming(searchResult, blkSearch);
   return result;
 }
 
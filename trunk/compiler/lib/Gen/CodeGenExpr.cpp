@@ -395,12 +395,14 @@ Value * CodeGenerator::genClearVar(const ClearVarExpr * in) {
 }
 
 Value * CodeGenerator::genAssignment(const AssignmentExpr * in) {
-  Value * lvalue = genLValueAddress(in->toExpr());
+  Value * object;
+  Value * lvalue = genStoreAddress(in->toExpr(), object);
   Value * rvalue = genExpr(in->fromExpr());
-  return doAssignment(in, lvalue, rvalue);
+  return doAssignment(in, lvalue, rvalue, object);
 }
 
-Value * CodeGenerator::doAssignment(const AssignmentExpr * in, Value * lvalue, Value * rvalue) {
+Value * CodeGenerator::doAssignment(const AssignmentExpr * in, Value * lvalue, Value * rvalue,
+    Value * object) {
   if (rvalue != NULL && lvalue != NULL) {
     // TODO: We could also do this via memcpy.
     TypeShape typeShape = in->fromExpr()->canonicalType()->typeShape();
@@ -419,7 +421,7 @@ Value * CodeGenerator::doAssignment(const AssignmentExpr * in, Value * lvalue, V
 
     if (in->exprType() == Expr::PostAssign) {
       Value * result = builder_.CreateLoad(lvalue);
-      builder_.CreateStore(rvalue, lvalue);
+      genStore(in->toExpr(), rvalue, lvalue, object);
       return result;
     } else {
       if (rvalue->getType() != lvalue->getType()->getContainedType(0)) {
@@ -429,7 +431,7 @@ Value * CodeGenerator::doAssignment(const AssignmentExpr * in, Value * lvalue, V
         exit(-1);
       }
 
-      builder_.CreateStore(rvalue, lvalue);
+      genStore(in->toExpr(), rvalue, lvalue, object);
       return rvalue;
     }
   }
@@ -437,6 +439,18 @@ Value * CodeGenerator::doAssignment(const AssignmentExpr * in, Value * lvalue, V
   return NULL;
 }
 
+void CodeGenerator::genStore(const Expr * lvalExpr, Value * rvalue, Value * lvalue,
+    Value * object) {
+  if (object == NULL) {
+    builder_.CreateStore(rvalue, lvalue);
+  } else if (isa<PointerType>(rvalue->getType())) {
+    genWriteBarrierStore(rvalue, object, lvalue);
+  } else {
+    genAggregateWriteBarriers(lvalExpr->canonicalType().unqualified(), object, lvalue);
+    builder_.CreateStore(rvalue, lvalue);
+  }
+}
+
 Value * CodeGenerator::genMultiAssign(const MultiAssignExpr * in) {
   ValueList fromVals;
 
@@ -451,12 +465,13 @@ Value * CodeGenerator::genMultiAssign(const MultiAssignExpr * in) {
   // Now store them.
   for (size_t i = 0; i < fromVals.size(); ++i) {
     const AssignmentExpr * assign = cast<AssignmentExpr>(in->arg(i));
-    Value * toVal = genLValueAddress(assign->toExpr());
+    Value * object;
+    Value * toVal = genStoreAddress(assign->toExpr(), object);
     if (toVal == NULL) {
       return NULL;
     }
 
-    doAssignment(assign, toVal, fromVals[i]);
+    doAssignment(assign, toVal, fromVals[i], object);
   }
 
   return voidValue_;
@@ -716,6 +731,103 @@ Value * CodeGenerator::genLValueAddress(const Expr * in) {
   }
 }
 
+Value * CodeGenerator::genStoreAddress(const Expr * in, Value *& object) {
+  // The llvm.gcwrite intrinsic can only be used in functions that have a collector.
+  object = NULL;
+  if (!builder_.GetInsertBlock()->getParent()->hasGC() ||
+      !in->canonicalType()->containsReferenceType()) {
+    return genLValueAddress(in);
+  }
+
+  switch (storeLocation(in)) {
+    case Store_Local:
+      return genLValueAddress(in);
+
+    case Store_Unknown: {
+      // The slot may still be in the heap, so it needs the barrier; but there is no object
+      // to give it, so the barrier works from the address of the slot.
+      Value * addr = genLValueAddress(in);
+      object = ConstantPointerNull::get(builder_.getInt8PtrTy());
+      return addr;
+    }
+
+    case Store_Heap:
+      break;
+  }
+
+  if (in->exprType() == Expr::LValue) {
+    const LValueExpr * lval = static_cast<const LValueExpr *>(in);
+    const VariableDefn * var = dyn_cast<VariableDefn>(lval->value());
+    if (var != NULL && var->isSharedRef()) {
+      // The shared cell is itself a heap object.
+      Value * cellAddr = lval->base() != NULL ? genMemberFieldAddr(lval) : genVarValue(var);
+      object = builder_.CreateLoad(cellAddr);
+      return builder_.CreateStructGEP(object, 1, var->name());
+    }
+  }
+
+  // The root of the GEP is the address of the object containing the field or element.
+  ValueList indices;
+  StrFormatStream labelStream;
+  object = genGEPIndices(in, indices, labelStream);
+  if (object == NULL) {
+    return NULL;
+  }
+
+  if (in->exprType() == Expr::LValue) {
+    ensureLValue(in, object->getType());
+  }
+
+  return builder_.CreateInBoundsGEP(object, indices, labelStream.str());
+}
+
+CodeGenerator::StoreLocation CodeGenerator::storeLocation(const Expr * in) {
+  const Expr * base;
+  switch (in->exprType()) {
+    case Expr::LValue: {
+      const LValueExpr * lval = static_cast<const LValueExpr *>(in);
+      if (const VariableDefn * var = dyn_cast<VariableDefn>(lval->value())) {
+        if (var->isSharedRef()) {
+          return Store_Heap;
+        }
+      }
+
+      base = lval->base();
+      if (base == NULL) {
+        // A value passed by reference, such as the 'self' of a struct method, may be
+        // embedded in an object.
+        const ParameterDefn * param = dyn_cast<ParameterDefn>(lval->value());
+        if (param != NULL && param->getFlag(ParameterDefn::Reference)) {
+          return Store_Unknown;
+        }
+        return Store_Local;
+      }
+      break;
+    }
+
+    case Expr::ElementRef: {
+      base = static_cast<const BinaryExpr *>(in)->first();
+      if (base->type()->typeClass() == Type::NAddress) {
+        return Store_Unknown;
+      }
+      break;
+    }
+
+    case Expr::PtrDeref:
+      return Store_Unknown;
+
+    default:
+      return Store_Local;
+  }
+
+  // A member of an object is in the heap, and so is a member of a struct or array which
+  // is embedded in an object.
+  if (base->canonicalType()->isReferenceType()) {
+    return Store_Heap;
+  }
+  return storeLocation(base);
+}
+
 Value * CodeGenerator::genLoadMemberField(const LValueExpr * lval, bool derefShared) {
   TypeShape baseShape = lval->base()->type()->typeShape();
 
@@ -1130,8 +1242,7 @@ Value * CodeGenerator::genClosureEnv(const ClosureEnvExpr * in) {
     DASSERT(envType->super() != NULL);
 
     // Allocate the environment.
-    Value * env = builder_.CreateCall2(
-        getGcAlloc(), gcAllocContext_,
+    Value * env = genGcAlloc(
         llvm::ConstantExpr::getIntegerCast(
             llvm::ConstantExpr::getSizeOf(envType->irTypeComplete()),
             intPtrType_, false),
@@ -1188,7 +1299,7 @@ Value * CodeGenerator::genVarSizeAlloc(const Type * objType, Value * sizeValue)
   DASSERT(sizeValue->getType() == intPtrType_);
   StrFormatStream labelStream;
   labelStream << objType;
-  Value * alloc = builder_.CreateCall2(getGcAlloc(), gcAllocContext_, sizeValue, labelStream.str());
+  Value * alloc = genGcAlloc(sizeValue, labelStream.str());
   Value * instance = builder_.CreateBitCast(alloc, resultType);
 
   if (const CompositeType * classType = dyn_cast<CompositeType>(objType)) {
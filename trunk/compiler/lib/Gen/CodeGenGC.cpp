@@ -135,7 +135,8 @@ void CodeGenerator::pushRoots(LocalScope * scope) {
       if (VariableDefn * var = dyn_cast<VariableDefn>(de)) {
         if (var->isSharedRef()) {
           pushGCRoot(var->irValue(), var->sharedRefType());
-        } else if (var->hasStorage() && var->type()->containsReferenceType()) {
+        } else if (var->hasStorage() && var->type()->containsReferenceType() &&
+            !var->isStackObject()) {
           pushGCRoot(var->irValue(), var->type().unqualified());
         }
       }
@@ -150,6 +151,83 @@ void CodeGenerator::popRootStack(size_t level) {
   }
 }
 
+void CodeGenerator::genWriteBarrierStore(Value * value, Value * object, Value * slot) {
+  Function * gcwrite = llvm::Intrinsic::getDeclaration(irModule_, llvm::Intrinsic::gcwrite);
+  llvm::PointerType * bytePtrType = builder_.getInt8PtrTy();
+  builder_.CreateCall3(gcwrite,
+      builder_.CreatePointerCast(value, bytePtrType),
+      builder_.CreatePointerCast(object, bytePtrType),
+      builder_.CreatePointerCast(slot, bytePtrType->getPointerTo()));
+}
+
+void CodeGenerator::genAggregateWriteBarriers(const Type * type, Value * object, Value * addr) {
+  // Use the same offsets as the trace table. References inside of unions which also
+  // contain non-reference types are traced by a method rather than by offset, so they
+  // are not covered here.
+  ConstantList traceTable;
+  ConstantList fieldOffsets;
+  ConstantList indices;
+  indices.push_back(getInt32Val(0));
+  llvm::Constant * basePtr = llvm::ConstantPointerNull::get(type->irType()->getPointerTo());
+  createTraceTableEntries(type, basePtr, traceTable, fieldOffsets, indices);
+
+  // Re-store the current value of each reference field through the barrier.
+  llvm::PointerType * bytePtrType = builder_.getInt8PtrTy();
+  Value * baseAddr = builder_.CreatePointerCast(addr, bytePtrType);
+  for (ConstantList::const_iterator it = fieldOffsets.begin(); it != fieldOffsets.end(); ++it) {
+    Value * slot = builder_.CreatePointerCast(
+        builder_.CreateInBoundsGEP(baseAddr, *it), bytePtrType->getPointerTo());
+    genWriteBarrierStore(builder_.CreateLoad(slot), object, slot);
+  }
+}
+
+void CodeGenerator::genWriteBarrierRange(const Type * elemType, Value * first, Value * count) {
+  if (!builder_.GetInsertBlock()->getParent()->hasGC()) {
+    return;
+  }
+
+  // The barrier visits the reference fields of each element, using the same offsets as
+  // the trace table, so that non-reference fields are never logged as pointers.
+  ConstantList fieldOffsets;
+  if (elemType->isReferenceType()) {
+    fieldOffsets.push_back(llvm::ConstantInt::get(intPtrType_, 0));
+  } else {
+    ConstantList traceTable;
+    ConstantList indices;
+    indices.push_back(getInt32Val(0));
+    llvm::Constant * basePtr = llvm::ConstantPointerNull::get(elemType->irType()->getPointerTo());
+    createTraceTableEntries(elemType, basePtr, traceTable, fieldOffsets, indices);
+    if (fieldOffsets.empty()) {
+      return;
+    }
+  }
+
+  llvm::SmallString<64> offsetsName(".barrieroffsets.");
+  typeLinkageName(offsetsName, elemType);
+  llvm::Constant * offsetsTable = ConstantArray::get(
+      ArrayType::get(intPtrType_, fieldOffsets.size()), fieldOffsets);
+  GlobalVariable * offsetsVar = irModule_->getGlobalVariable(offsetsName, true);
+  if (offsetsVar == NULL) {
+    offsetsVar = new GlobalVariable(*irModule_, offsetsTable->getType(), true,
+        GlobalValue::LinkOnceODRLinkage, offsetsTable, Twine(offsetsName));
+  }
+
+  llvm::PointerType * bytePtrType = builder_.getInt8PtrTy();
+  llvm::PointerType * offsetsPtrType = intPtrType_->getPointerTo();
+  Constant * barrierFn = irModule_->getOrInsertFunction("GC_writeBarrierRange",
+      builder_.getVoidTy(), bytePtrType, intPtrType_, intPtrType_, offsetsPtrType, intPtrType_,
+      NULL);
+  Value * args[] = {
+    builder_.CreatePointerCast(first, bytePtrType),
+    builder_.CreateIntCast(count, intPtrType_, false),
+    llvm::ConstantExpr::getTruncOrBitCast(
+        llvm::ConstantExpr::getSizeOf(elemType->irEmbeddedType()), intPtrType_),
+    llvm::ConstantExpr::getPointerCast(offsetsVar, offsetsPtrType),
+    llvm::ConstantInt::get(intPtrType_, fieldOffsets.size()),
+  };
+  builder_.CreateCall(barrierFn, args);
+}
+
 Value * CodeGenerator::addTempRoot(const Type * type, Value * value, const Twine & name) {
   // Save the current insertion point
   IRBuilderBase::InsertPoint savePt = builder_.saveIP();
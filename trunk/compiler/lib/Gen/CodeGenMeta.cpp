@@ -10,11 +10,87 @@
 #include "tart/Meta/MDWriter.h"
 
 #include "llvm/Module.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <stdio.h>
 
 namespace tart {
 
 using namespace llvm;
 
+namespace {
+
+/// Computes a 64-bit FNV-1a hash of a tree of metadata, ignoring source locations.
+class InterfaceHasher {
+public:
+  InterfaceHasher(const MDWriter & writer) : writer_(writer) {}
+
+  uint64_t hash(const Value * value) {
+    uint64_t h = 14695981039346656037ull;
+    if (value == NULL) {
+      return combine(h, 'Z');
+    } else if (const MDString * str = dyn_cast<MDString>(value)) {
+      h = combine(h, 'S');
+      for (StringRef::const_iterator it = str->begin(); it != str->end(); ++it) {
+        h = combine(h, uint8_t(*it));
+      }
+
+      return h;
+    } else if (const MDNode * node = dyn_cast<MDNode>(value)) {
+      if (writer_.isLocation(node)) {
+        return combine(h, 'L');
+      }
+
+      // Nodes are uniqued, and often shared, so each is only hashed once.
+      DenseMap<const MDNode *, uint64_t>::const_iterator it = nodes_.find(node);
+      if (it != nodes_.end()) {
+        return it->second;
+      }
+
+      h = combine(h, 'N');
+      for (unsigned i = 0; i < node->getNumOperands(); ++i) {
+        h = combine(h, hash(node->getOperand(i)));
+      }
+
+      nodes_[node] = h;
+      return h;
+    } else if (const GlobalValue * gv = dyn_cast<GlobalValue>(value)) {
+      h = combine(h, 'G');
+      StringRef name = gv->getName();
+      for (StringRef::const_iterator it = name.begin(); it != name.end(); ++it) {
+        h = combine(h, uint8_t(*it));
+      }
+
+      return h;
+    } else if (const ConstantInt * ci = dyn_cast<ConstantInt>(value)) {
+      return combine(combine(h, 'I'), ci->getValue().getLimitedValue());
+    } else if (const User * user = dyn_cast<User>(value)) {
+      h = combine(combine(h, 'U'), value->getType()->getTypeID());
+      for (unsigned i = 0; i < user->getNumOperands(); ++i) {
+        h = combine(h, hash(user->getOperand(i)));
+      }
+
+      return h;
+    }
+
+    return combine(h, value->getValueID());
+  }
+
+private:
+  static uint64_t combine(uint64_t h, uint64_t value) {
+    for (int i = 0; i < 8; ++i, value >>= 8) {
+      h = (h ^ (value & 0xff)) * 1099511628211ull;
+    }
+
+    return h;
+  }
+
+  const MDWriter & writer_;
+  DenseMap<const MDNode *, uint64_t> nodes_;
+};
+
+}
+
 void CodeGenerator::genModuleMetadata() {
   MDWriter writer(*this);
   SmallString<128> mdName("tart.xdef.");
@@ -25,8 +101,15 @@ void CodeGenerator::genModuleMetadata() {
   md->addOperand(getModuleSource());
   md->addOperand(getModuleDeps());
   md->addOperand(getModuleTimestamp());
-  md->addOperand(writer.moduleImports());
+  MDNode * imports = writer.moduleImports();
+  md->addOperand(imports);
   md->addOperand(members);
+
+  // The build compares fingerprints to decide whether modules which import this one
+  // need to be recompiled.
+  MDNode * interface[] = { getFormatVersion(), imports, members };
+  irModule_->getOrInsertNamedMetadata("tart.interface_fingerprint")->addOperand(
+      getInterfaceFingerprint(writer, interface));
 }
 
 MDNode * CodeGenerator::getFormatVersion() {
@@ -57,6 +140,20 @@ MDNode * CodeGenerator::getModuleDeps() {
   return MDNode::get(context_, values);
 }
 
+MDNode * CodeGenerator::getInterfaceFingerprint(const MDWriter & writer,
+    ArrayRef<MDNode *> nodes) {
+  InterfaceHasher hasher(writer);
+  uint64_t hash = 0;
+  for (ArrayRef<MDNode *>::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+    hash = hash * 31 + hasher.hash(*it);
+  }
+
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%08x%08x", unsigned(hash >> 32), unsigned(hash));
+  Value * fingerprint = MDString::get(context_, hex);
+  return MDNode::get(context_, fingerprint);
+}
+
 MDNode * CodeGenerator::getModuleTimestamp() {
   Value * modTimestamp[2];
   modTimestamp[0] = ConstantInt::get(builder_.getInt64Ty(), module_->timestamp().seconds());
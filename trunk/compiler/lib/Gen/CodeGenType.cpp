@@ -28,6 +28,7 @@
 #include "llvm/DerivedTypes.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Support/Format.h"
+#include "llvm/ADT/StringExtras.h"
 
 namespace tart {
 
@@ -41,11 +42,20 @@ namespace reflect {
   }
 }
 
+// How much larger than the number of interfaces an interface table can be made, in order
+// to avoid collisions.
+static const size_t ITABLE_MAX_GROWTH = 4;
+
 // Members of tart.core.TypeInfoBlock.
 SystemClassMember<VariableDefn> tib_type(Builtins::typeTypeInfoBlock, "type");
 SystemClassMember<VariableDefn> tib_bases(Builtins::typeTypeInfoBlock, "bases");
+SystemClassMember<VariableDefn> tib_display(Builtins::typeTypeInfoBlock, "display");
+SystemClassMember<VariableDefn> tib_interfaceBits(Builtins::typeTypeInfoBlock, "interfaceBits");
+SystemClassMember<VariableDefn> tib_depth(Builtins::typeTypeInfoBlock, "depth");
 SystemClassMember<VariableDefn> tib_traceTable(Builtins::typeTypeInfoBlock, "traceTable");
 SystemClassMember<VariableDefn> tib_idispatch(Builtins::typeTypeInfoBlock, "idispatch");
+SystemClassMember<VariableDefn> tib_itable(Builtins::typeTypeInfoBlock, "itable");
+SystemClassMember<VariableDefn> tib_itableMask(Builtins::typeTypeInfoBlock, "itableMask");
 
 llvm::Type * CodeGenerator::genTypeDefn(TypeDefn * tdef) {
   DASSERT_OBJ(tdef->isSingular(), tdef);
@@ -152,11 +162,13 @@ bool CodeGenerator::createTypeInfoBlock(RuntimeTypeInfo * rtype) {
   }
 
   // Interfaces next
+  uint64_t interfaceBits = 0;
   for (ClassSet::iterator it = baseClassSet.begin(); it != baseClassSet.end(); ++it) {
     CompositeType * baseType = *it;
     if (baseType->typeClass() == Type::Interface) {
       //genCompositeType(baseType);
       baseClassList.push_back(getTypeInfoBlockPtr(baseType));
+      interfaceBits |= interfaceBit(baseType);
     }
   }
 
@@ -170,6 +182,26 @@ bool CodeGenerator::createTypeInfoBlock(RuntimeTypeInfo * rtype) {
     baseClassArray->getType(), true, GlobalValue::LinkOnceAnyLinkage,
     baseClassArray, type->typeDefn()->linkageName() + ".TIB.bases");
 
+  // Generate the display: the superclasses in order of depth, followed by the class itself.
+  Constant * display = NULL;
+  int32_t depth = -1;
+  if (type->typeClass() == Type::Class) {
+    ConstantList displayList;
+    displayList.push_back(getTypeInfoBlockPtr(type));
+    for (const CompositeType * s = type->super(); s != NULL; s = s->super()) {
+      displayList.insert(displayList.begin(), getTypeInfoBlockPtr(s));
+    }
+
+    depth = int32_t(displayList.size()) - 1;
+    DASSERT(depth == classDepth(type));
+    Constant * displayArray = ConstantArray::get(
+        ArrayType::get(typePointerType, displayList.size()), displayList);
+    GlobalVariable * displayArrayPtr = new GlobalVariable(*irModule_,
+      displayArray->getType(), true, GlobalValue::LinkOnceAnyLinkage,
+      displayArray, type->typeDefn()->linkageName() + ".TIB.display");
+    display = llvm::ConstantExpr::getPointerCast(displayArrayPtr, typePointerType->getPointerTo());
+  }
+
   // Generate the interface dispatch function
   Function * idispatch = NULL;
   if (type->typeClass() == Type::Class) {
@@ -193,11 +225,25 @@ bool CodeGenerator::createTypeInfoBlock(RuntimeTypeInfo * rtype) {
   }
 
   builder.addField(baseClassArrayPtr);
+  if (display != NULL) {
+    builder.addField(display);
+  } else {
+    builder.addNullField(tib_display);
+  }
+
+  builder.addField(ConstantInt::get(builder_.getInt64Ty(), interfaceBits));
+  builder.addIntegerField(tib_depth, depth);
   if (type->typeClass() == Type::Class) {
+    int32_t itableMask;
+    Constant * itable = genInterfaceTable(type, itableMask);
     builder.addField(idispatch);
+    builder.addField(itable);
+    builder.addIntegerField(tib_itableMask, itableMask);
     builder.addField(genMethodArray(type->instanceMethods_));
   } else {
     builder.addNullField(tib_idispatch);
+    builder.addNullField(tib_itable);
+    builder.addIntegerField(tib_itableMask, 0);
     builder.addField(genMethodArray(MethodList()));
   }
 
@@ -258,7 +304,7 @@ Constant * CodeGenerator::genMethodArray(const MethodList & methods) {
         methodVal = genCallableDefn(method);
       } else if (method->isAbstract()) {
         methodVal = ConstantPointerNull::get(methodPtrType_);
-      } else if (method->mdNode() != NULL) {
+      } else if (!method->mdNode().isNull()) {
         methodVal = genFunctionValue(method);
       } else {
         diag.fatal(method) << "Method with no body: " << method;
@@ -297,7 +343,6 @@ Function * CodeGenerator::genInterfaceDispatchFunc(const CompositeType * type) {
       irModule_);
 
   // Generate the interface dispatcher body
-  StringRef linkageName = type->typeDefn()->linkageName();
   BasicBlock * savePoint = builder_.GetInsertBlock();
 
   Function::ArgumentListType::iterator arg = idispatch->getArgumentList().begin();
@@ -316,11 +361,7 @@ Function * CodeGenerator::genInterfaceDispatchFunc(const CompositeType * type) {
 
     // Generate the method table for the interface.
     CompositeType * itDecl = it->interfaceType;
-    Constant * itableMembers = genMethodArray(it->methods);
-    GlobalVariable * itable = new GlobalVariable(*irModule_,
-      itableMembers->getType(), true, GlobalValue::InternalLinkage,
-      itableMembers,
-      itDecl->typeDefn()->linkageName() + "->" + linkageName);
+    GlobalVariable * itable = getInterfaceMethodTable(type, it->interfaceType, it->methods);
     Constant * iname = reflector_.internSymbol(itDecl->typeDefn()->linkageName());
 
     // Create the blocks
@@ -356,6 +397,92 @@ Function * CodeGenerator::genInterfaceDispatchFunc(const CompositeType * type) {
   return idispatch;
 }
 
+GlobalVariable * CodeGenerator::getInterfaceMethodTable(const CompositeType * type,
+    const CompositeType * iftype, const MethodList & methods) {
+  std::string itableName(iftype->typeDefn()->linkageName());
+  itableName.append("->");
+  itableName.append(type->typeDefn()->linkageName());
+  GlobalVariable * itable = irModule_->getGlobalVariable(itableName, true);
+  if (itable == NULL) {
+    Constant * itableMembers = genMethodArray(methods);
+    itable = new GlobalVariable(*irModule_,
+      itableMembers->getType(), true, GlobalValue::InternalLinkage,
+      itableMembers, itableName);
+  }
+
+  return itable;
+}
+
+uint32_t CodeGenerator::interfaceHash(const CompositeType * iftype) {
+  return llvm::HashString(iftype->typeDefn()->linkageName());
+}
+
+uint64_t CodeGenerator::interfaceBit(const CompositeType * iftype) {
+  // Use the high bits of the hash, since the low bits select the slot in the itable.
+  return uint64_t(1) << (interfaceHash(iftype) >> 26);
+}
+
+int32_t CodeGenerator::classDepth(const CompositeType * cls) {
+  int32_t depth = 0;
+  for (const CompositeType * s = cls->super(); s != NULL; s = s->super()) {
+    ++depth;
+  }
+
+  return depth;
+}
+
+Constant * CodeGenerator::genInterfaceTable(const CompositeType * type, int32_t & mask) {
+  const CompositeType::InterfaceList & interfaces = type->interfaces_;
+
+  // Find the smallest power-of-two table in which no two interfaces hash to the same slot,
+  // giving up once the table has grown to ITABLE_MAX_GROWTH times the minimum size.
+  // Interfaces which still collide are left out of the table, and are found by the
+  // dispatcher function instead.
+  size_t size = 1;
+  while (size < interfaces.size()) {
+    size <<= 1;
+  }
+
+  for (size_t limit = size * ITABLE_MAX_GROWTH; size < limit; size <<= 1) {
+    llvm::SmallVector<bool, 16> used(size, false);
+    bool collision = false;
+    for (CompositeType::InterfaceList::const_iterator it = interfaces.begin();
+        it != interfaces.end() && !collision; ++it) {
+      size_t slot = interfaceHash(it->interfaceType) & (size - 1);
+      collision = used[slot];
+      used[slot] = true;
+    }
+
+    if (!collision) {
+      break;
+    }
+  }
+
+  // Each slot is a pair of pointers: the interned name of the interface, and its method
+  // table. Empty slots are null.
+  ConstantList slots(size * 2, ConstantPointerNull::get(methodPtrType_));
+  for (CompositeType::InterfaceList::const_iterator it = interfaces.begin();
+      it != interfaces.end(); ++it) {
+    size_t slot = (interfaceHash(it->interfaceType) & (size - 1)) * 2;
+    if (!slots[slot]->isNullValue()) {
+      continue;
+    }
+
+    Constant * iname = reflector_.internSymbol(it->interfaceType->typeDefn()->linkageName());
+    slots[slot] = llvm::ConstantExpr::getBitCast(iname, methodPtrType_);
+    slots[slot + 1] = llvm::ConstantExpr::getBitCast(
+        getInterfaceMethodTable(type, it->interfaceType, it->methods), methodPtrType_);
+  }
+
+  Constant * tableValue = ConstantArray::get(ArrayType::get(methodPtrType_, slots.size()), slots);
+  GlobalVariable * table = new GlobalVariable(*irModule_,
+    tableValue->getType(), true, GlobalValue::InternalLinkage,
+    tableValue, type->typeDefn()->linkageName() + ".TIB.itable");
+
+  mask = int32_t(size - 1);
+  return llvm::ConstantExpr::getPointerCast(table, methodPtrType_->getPointerTo());
+}
+
 void CodeGenerator::genInitObjVTable(const CompositeType * type, Value * instance) {
   DASSERT(type->typeClass() == Type::Class) << "Invalid type for vtable: " << type;
   ValueList indices;
@@ -736,6 +863,11 @@ llvm::Constant * CodeGenerator::genProxyType(const CompositeType * iftype) {
 
   // Null pointer at end
   llvm::PointerType * typePointerType = Builtins::typeTypeInfoBlock.irType()->getPointerTo();
+  uint64_t interfaceBits = 0;
+  for (ClassSet::iterator it = baseClassSet.begin(); it != baseClassSet.end(); ++it) {
+    interfaceBits |= interfaceBit(*it);
+  }
+
   baseClassList.push_back(ConstantPointerNull::get(typePointerType));
 
   Constant * baseClassArray = ConstantArray::get(
@@ -756,9 +888,17 @@ llvm::Constant * CodeGenerator::genProxyType(const CompositeType * iftype) {
 
   // Create the TypeInfoBlock struct
   StructBuilder builder(*this);
+  int32_t itableMask;
+  Constant * itable = genInterfaceTable(iftype, itableMask);
   builder.addField(reflector_.internSymbol(proxyTypeName));
+  builder.addNullField(tib_traceTable);
   builder.addField(baseClassArrayPtr);
+  builder.addNullField(tib_display);
+  builder.addField(ConstantInt::get(builder_.getInt64Ty(), interfaceBits));
+  builder.addIntegerField(tib_depth, -1);
   builder.addField(idispatch);
+  builder.addField(itable);
+  builder.addIntegerField(tib_itableMask, itableMask);
   builder.addField(genMethodArray(iftype->instanceMethods_));
 
   Constant * tibStruct = builder.buildAnon();
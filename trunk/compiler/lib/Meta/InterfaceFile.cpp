@@ -0,0 +1,367 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include "tart/Meta/InterfaceFile.h"
+
+#include "llvm/Constants.h"
+#include "llvm/GlobalValue.h"
+#include "llvm/Metadata.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include <algorithm>
+
+namespace tart {
+
+using namespace llvm;
+
+namespace {
+  void writeWord(raw_ostream & out, uint32_t value) {
+    out << char(value) << char(value >> 8) << char(value >> 16) << char(value >> 24);
+  }
+
+  bool moduleNameLess(const std::pair<std::string, uint32_t> & a,
+      const std::pair<std::string, uint32_t> & b) {
+    return a.first < b.first;
+  }
+}
+
+// -------------------------------------------------------------------
+// InterfaceFile
+
+InterfaceFile::InterfaceFile(MemoryBuffer * buffer)
+  : buffer_(buffer)
+  , data_(reinterpret_cast<const unsigned char *>(buffer->getBufferStart()))
+  , stringCount_(0)
+  , stringIndex_(0)
+  , nodeCount_(0)
+  , nodeIndex_(0)
+  , moduleCount_(0)
+  , moduleIndex_(0)
+{
+}
+
+InterfaceFile * InterfaceFile::open(StringRef path, std::string & errorInfo) {
+  // Large files are mapped rather than copied, as long as they don't need to be
+  // null terminated.
+  OwningPtr<MemoryBuffer> buffer;
+  if (error_code ec = MemoryBuffer::getFile(path, buffer, -1, false)) {
+    errorInfo = ec.message();
+    return NULL;
+  }
+
+  return open(buffer.take(), errorInfo);
+}
+
+InterfaceFile * InterfaceFile::open(MemoryBuffer * buffer, std::string & errorInfo) {
+  OwningPtr<InterfaceFile> file(new InterfaceFile(buffer));
+  if (!file->validate(errorInfo)) {
+    return NULL;
+  }
+
+  return file.take();
+}
+
+bool InterfaceFile::validate(std::string & errorInfo) {
+  size_t size = buffer_->getBufferSize();
+  if (size < HEADER_SIZE || word(0) != MAGIC) {
+    errorInfo = "not a module interface file";
+    return false;
+  }
+
+  if (word(4) != VERSION) {
+    errorInfo = "unsupported module interface file version";
+    return false;
+  }
+
+  // Check that the index tables lie within the file.
+  stringCount_ = word(8);
+  stringIndex_ = word(12);
+  nodeCount_ = word(16);
+  nodeIndex_ = word(20);
+  moduleCount_ = word(24);
+  moduleIndex_ = word(28);
+  if (uint64_t(stringIndex_) + uint64_t(stringCount_) * 8 > size ||
+      uint64_t(nodeIndex_) + uint64_t(nodeCount_) * 8 > size ||
+      uint64_t(moduleIndex_) + uint64_t(moduleCount_) * 8 > size) {
+    errorInfo = "module interface file is truncated";
+    return false;
+  }
+
+  // The accessors only assert on their arguments, so every entry that they might read
+  // has to be checked here. A truncated or corrupt file would otherwise cause reads
+  // outside of the buffer.
+  for (uint32_t i = 0; i < stringCount_; ++i) {
+    uint32_t entry = stringIndex_ + i * 8;
+    if (uint64_t(word(entry)) + word(entry + 4) > size) {
+      errorInfo = "module interface file has an invalid string";
+      return false;
+    }
+  }
+
+  for (uint32_t i = 0; i < nodeCount_; ++i) {
+    uint32_t entry = nodeIndex_ + i * 8;
+    uint32_t offset = word(entry);
+    uint32_t count = word(entry + 4);
+    if (uint64_t(offset) + uint64_t(count) * OPERAND_SIZE > size) {
+      errorInfo = "module interface file has an invalid node";
+      return false;
+    }
+
+    for (uint32_t n = 0; n < count; ++n, offset += OPERAND_SIZE) {
+      uint32_t value = word(offset + 4);
+      switch (word(offset) & 0xff) {
+        case OPERAND_NULL:
+        case OPERAND_INT:
+          break;
+
+        case OPERAND_STRING:
+        case OPERAND_SYMBOL:
+          if (value >= stringCount_) {
+            errorInfo = "module interface file has an invalid string reference";
+            return false;
+          }
+          break;
+
+        case OPERAND_NODE:
+          if (value >= nodeCount_) {
+            errorInfo = "module interface file has an invalid node reference";
+            return false;
+          }
+          break;
+
+        default:
+          errorInfo = "module interface file has an invalid operand";
+          return false;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < moduleCount_; ++i) {
+    uint32_t entry = moduleIndex_ + i * 8;
+    if (word(entry) >= stringCount_ || word(entry + 4) >= nodeCount_) {
+      errorInfo = "module interface file has an invalid module";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint32_t InterfaceFile::word(uint32_t offset) const {
+  const unsigned char * p = data_ + offset;
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) |
+      (uint32_t(p[3]) << 24);
+}
+
+StringRef InterfaceFile::string(uint32_t index) const {
+  assert(index < stringCount_);
+  uint32_t entry = stringIndex_ + index * 8;
+  return StringRef(reinterpret_cast<const char *>(data_) + word(entry), word(entry + 4));
+}
+
+uint32_t InterfaceFile::operandOffset(uint32_t node, unsigned n) const {
+  assert(node < nodeCount_);
+  assert(n < nodeSize(node));
+  return word(nodeIndex_ + node * 8) + n * OPERAND_SIZE;
+}
+
+bool InterfaceFile::findModule(StringRef qualifiedName, uint32_t & node) const {
+  // Binary search of the module index.
+  uint32_t lo = 0;
+  uint32_t hi = moduleCount_;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    uint32_t entry = moduleIndex_ + mid * 8;
+    int cmp = string(word(entry)).compare(qualifiedName);
+    if (cmp == 0) {
+      node = word(entry + 4);
+      return true;
+    } else if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return false;
+}
+
+unsigned InterfaceFile::nodeSize(uint32_t node) const {
+  assert(node < nodeCount_);
+  return word(nodeIndex_ + node * 8 + 4);
+}
+
+InterfaceFile::OperandKind InterfaceFile::operandKind(uint32_t node, unsigned n) const {
+  return OperandKind(word(operandOffset(node, n)) & 0xff);
+}
+
+unsigned InterfaceFile::intWidth(uint32_t node, unsigned n) const {
+  assert(operandKind(node, n) == OPERAND_INT);
+  return word(operandOffset(node, n)) >> 8;
+}
+
+uint64_t InterfaceFile::intValue(uint32_t node, unsigned n) const {
+  assert(operandKind(node, n) == OPERAND_INT);
+  uint32_t offset = operandOffset(node, n);
+  return uint64_t(word(offset + 4)) | (uint64_t(word(offset + 8)) << 32);
+}
+
+StringRef InterfaceFile::stringValue(uint32_t node, unsigned n) const {
+  assert(operandKind(node, n) == OPERAND_STRING || operandKind(node, n) == OPERAND_SYMBOL);
+  return string(word(operandOffset(node, n) + 4));
+}
+
+uint32_t InterfaceFile::nodeValue(uint32_t node, unsigned n) const {
+  assert(operandKind(node, n) == OPERAND_NODE);
+  return word(operandOffset(node, n) + 4);
+}
+
+// -------------------------------------------------------------------
+// InterfaceFileWriter
+
+bool InterfaceFileWriter::addModule(StringRef qualifiedName, const NamedMDNode * md) {
+  uint32_t index = nodes_.size();
+  nodes_.push_back(OperandList());
+
+  OperandList root(md->getNumOperands());
+  for (unsigned i = 0; i < md->getNumOperands(); ++i) {
+    if (!addOperand(md->getOperand(i), root[i])) {
+      return false;
+    }
+  }
+
+  nodes_[index].swap(root);
+  addString(qualifiedName);
+  modules_.push_back(std::make_pair(qualifiedName.str(), index));
+  return true;
+}
+
+bool InterfaceFileWriter::addNode(const MDNode * node, uint32_t & index) {
+  NodeIndexMap::const_iterator it = nodeIndices_.find(node);
+  if (it != nodeIndices_.end()) {
+    index = it->second;
+    return true;
+  }
+
+  // Metadata nodes are uniqued, so shared subtrees are only written once.
+  index = nodes_.size();
+  nodeIndices_[node] = index;
+  nodes_.push_back(OperandList());
+
+  OperandList operands(node->getNumOperands());
+  for (unsigned i = 0; i < node->getNumOperands(); ++i) {
+    if (!addOperand(node->getOperand(i), operands[i])) {
+      return false;
+    }
+  }
+
+  nodes_[index].swap(operands);
+  return true;
+}
+
+bool InterfaceFileWriter::addOperand(const Value * value, Operand & result) {
+  result.width = 0;
+  result.value = 0;
+  if (value == NULL) {
+    result.kind = InterfaceFile::OPERAND_NULL;
+  } else if (const MDNode * node = dyn_cast<MDNode>(value)) {
+    uint32_t index;
+    if (!addNode(node, index)) {
+      return false;
+    }
+
+    result.kind = InterfaceFile::OPERAND_NODE;
+    result.value = index;
+  } else if (const MDString * str = dyn_cast<MDString>(value)) {
+    result.kind = InterfaceFile::OPERAND_STRING;
+    result.value = addString(str->getString());
+  } else if (const ConstantInt * cint = dyn_cast<ConstantInt>(value)) {
+    if (cint->getBitWidth() > 64) {
+      return false;
+    }
+
+    result.kind = InterfaceFile::OPERAND_INT;
+    result.width = cint->getBitWidth();
+    result.value = cint->getZExtValue();
+  } else if (const GlobalValue * gv =
+      dyn_cast<GlobalValue>(const_cast<Value *>(value)->stripPointerCasts())) {
+    // Function values are recorded by name only; the compiler doesn't read them.
+    result.kind = InterfaceFile::OPERAND_SYMBOL;
+    result.value = addString(gv->getName());
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+uint32_t InterfaceFileWriter::addString(StringRef str) {
+  StringMapEntry<uint32_t> & entry = stringIndices_.GetOrCreateValue(str, uint32_t(-1));
+  if (entry.getValue() == uint32_t(-1)) {
+    entry.setValue(strings_.size());
+    strings_.push_back(entry.getKey());
+  }
+
+  return entry.getValue();
+}
+
+void InterfaceFileWriter::write(raw_ostream & out) const {
+  uint32_t operandCount = 0;
+  for (std::vector<OperandList>::const_iterator it = nodes_.begin(); it != nodes_.end(); ++it) {
+    operandCount += it->size();
+  }
+
+  // Compute the layout of the file.
+  uint32_t stringIndex = InterfaceFile::HEADER_SIZE;
+  uint32_t nodeIndex = stringIndex + strings_.size() * 8;
+  uint32_t moduleIndex = nodeIndex + nodes_.size() * 8;
+  uint32_t operands = moduleIndex + modules_.size() * 8;
+  uint32_t stringData = operands + operandCount * InterfaceFile::OPERAND_SIZE;
+
+  writeWord(out, InterfaceFile::MAGIC);
+  writeWord(out, InterfaceFile::VERSION);
+  writeWord(out, strings_.size());
+  writeWord(out, stringIndex);
+  writeWord(out, nodes_.size());
+  writeWord(out, nodeIndex);
+  writeWord(out, modules_.size());
+  writeWord(out, moduleIndex);
+
+  uint32_t offset = stringData;
+  for (std::vector<StringRef>::const_iterator it = strings_.begin(); it != strings_.end(); ++it) {
+    writeWord(out, offset);
+    writeWord(out, it->size());
+    offset += it->size();
+  }
+
+  offset = operands;
+  for (std::vector<OperandList>::const_iterator it = nodes_.begin(); it != nodes_.end(); ++it) {
+    writeWord(out, offset);
+    writeWord(out, it->size());
+    offset += it->size() * InterfaceFile::OPERAND_SIZE;
+  }
+
+  ModuleList modules(modules_);
+  std::sort(modules.begin(), modules.end(), moduleNameLess);
+  for (ModuleList::const_iterator it = modules.begin(); it != modules.end(); ++it) {
+    writeWord(out, stringIndices_.lookup(it->first));
+    writeWord(out, it->second);
+  }
+
+  for (std::vector<OperandList>::const_iterator it = nodes_.begin(); it != nodes_.end(); ++it) {
+    for (OperandList::const_iterator op = it->begin(); op != it->end(); ++op) {
+      writeWord(out, op->kind | (op->width << 8));
+      writeWord(out, uint32_t(op->value));
+      writeWord(out, uint32_t(op->value >> 32));
+    }
+  }
+
+  for (std::vector<StringRef>::const_iterator it = strings_.begin(); it != strings_.end(); ++it) {
+    out << *it;
+  }
+}
+
+} // namespace tart
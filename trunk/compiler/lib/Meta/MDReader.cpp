@@ -15,6 +15,7 @@
 
 #include "tart/Expr/Exprs.h"
 
+#include "tart/Meta/InterfaceFile.h"
 #include "tart/Meta/Tags.h"
 #include "tart/Meta/VarInt.h"
 #include "tart/Meta/ASTReader.h"
@@ -33,6 +34,8 @@
 
 #include "llvm/Metadata.h"
 #include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/LLVMContext.h"
 
 #include "config_paths.h"
 
@@ -44,82 +47,197 @@ using namespace llvm;
 // NodeRef
 
 unsigned NodeRef::size() const {
-  return node_ ? node_->getNumOperands() : 0;
+  if (file_ != NULL) {
+    return file_->nodeSize(index_);
+  }
+
+  return md_ ? md_->getNumOperands() : 0;
 }
 
 llvm::Value * NodeRef::arg(unsigned n) const {
-  if (node_->getNumOperands() <= n) {
+  if (md_->getNumOperands() <= n) {
     diag.error() << "Attempt to access operand # " << n <<
         " from a metadata node with only " << size() << " operands.";
-    node_->dump();
+    md_->dump();
     DFAIL("IllegalState");
   }
 
-  return node_->getOperand(n);
+  return md_->getOperand(n);
+}
+
+void NodeRef::argError(unsigned n, const char * expected) const {
+  diag.error() << "Expected metadata operand # " << n << " to be " << expected;
+  if (md_ != NULL) {
+    md_->dump();
+  }
+
+  DFAIL("IllegalState");
 }
 
 uint32_t NodeRef::intArg(unsigned n) const {
-  const llvm::Value * val = arg(n);
-  if (const ConstantInt * ci = dyn_cast_or_null<ConstantInt>(val)) {
+  if (file_ != NULL) {
+    if (file_->operandKind(index_, n) == InterfaceFile::OPERAND_INT) {
+      return uint32_t(file_->intValue(index_, n));
+    }
+  } else if (const ConstantInt * ci = dyn_cast_or_null<ConstantInt>(arg(n))) {
     return uint32_t(ci->getValue().getZExtValue());
   }
 
-  diag.error() << "Expected metadata operand # " << n << " to be an integer";
-  node_->dump();
-  DFAIL("IllegalState");
+  argError(n, "an integer");
   return 0;
 }
 
+ConstantInt * NodeRef::constIntArg(unsigned n) const {
+  if (file_ != NULL) {
+    if (file_->operandKind(index_, n) == InterfaceFile::OPERAND_INT) {
+      return ConstantInt::get(
+          IntegerType::get(getGlobalContext(), file_->intWidth(index_, n)),
+          file_->intValue(index_, n));
+    }
+  } else if (ConstantInt * ci = dyn_cast_or_null<ConstantInt>(arg(n))) {
+    return ci;
+  }
+
+  argError(n, "an integer");
+  return NULL;
+}
+
 StringRef NodeRef::strArg(unsigned n) const {
-  const llvm::Value * val = arg(n);
-  if (const MDString * str = dyn_cast_or_null<MDString>(val)) {
+  if (file_ != NULL) {
+    if (file_->operandKind(index_, n) == InterfaceFile::OPERAND_STRING) {
+      return file_->stringValue(index_, n);
+    }
+  } else if (const MDString * str = dyn_cast_or_null<MDString>(arg(n))) {
     return str->getString();
   }
 
-  diag.error() << "Expected metadata operand # " << n << " to be an MDString";
-  node_->dump();
-  DFAIL("IllegalState");
+  argError(n, "an MDString");
   return StringRef();
 }
 
 StringRef NodeRef::optStrArg(unsigned n) const {
-  const llvm::Value * val = arg(n);
-  if (val == NULL) {
+  if (file_ != NULL) {
+    if (file_->operandKind(index_, n) == InterfaceFile::OPERAND_NULL) {
+      return StringRef();
+    }
+  } else if (arg(n) == NULL) {
     return StringRef();
-  } else if (const MDString * str = dyn_cast_or_null<MDString>(val)) {
-    return str->getString();
   }
 
-  diag.error() << "Expected metadata operand # " << n << " to be an MDString";
-  node_->dump();
-  DFAIL("IllegalState");
-  return StringRef();
+  return strArg(n);
 }
 
 NodeRef NodeRef::nodeArg(unsigned n) const {
-  const llvm::Value * val = arg(n);
-  if (const MDNode * md = dyn_cast_or_null<MDNode>(val)) {
+  if (file_ != NULL) {
+    if (file_->operandKind(index_, n) == InterfaceFile::OPERAND_NODE) {
+      return NodeRef(file_, file_->nodeValue(index_, n));
+    }
+  } else if (const MDNode * md = dyn_cast_or_null<MDNode>(arg(n))) {
     return md;
   }
 
-  diag.error() << "Expected metadata operand # " << n << " to be an MDNode";
-  node_->dump();
-  DFAIL("IllegalState");
-  return NodeRef(NULL);
+  argError(n, "an MDNode");
+  return NodeRef();
 }
 
 NodeRef NodeRef::optNodeArg(unsigned n) const {
-  const llvm::Value * val = arg(n);
-  if (val == NULL) {
-    return NULL;
-  } else if (const MDNode * md = dyn_cast<MDNode>(val)) {
-    return md;
+  if (file_ != NULL) {
+    if (file_->operandKind(index_, n) == InterfaceFile::OPERAND_NULL) {
+      return NodeRef();
+    }
+  } else if (arg(n) == NULL) {
+    return NodeRef();
   }
 
-  diag.error() << "Expected metadata operand # " << n << " to be an MDNode";
-  node_->dump();
-  DFAIL("IllegalState");
-  return NodeRef(NULL);
+  return nodeArg(n);
+}
+
+// -------------------------------------------------------------------
+// MDMemberLoader
+
+/** Creates the members of a scope from a metadata node as they are looked up.
+    Building the index only requires reading each member's name, so the types,
+    parameters and templates of members that are never referenced are never read. */
+class MDMemberLoader : public MemberLoader {
+public:
+  MDMemberLoader(Module * module, NodeRef members, IterableScope * scope, Defn * parentDefn,
+      StorageClass storage);
+
+  void loadMembers(StringRef name) { loadNamedMembers(name); }
+  void loadAllMembers(DefnList & members);
+
+  /** Create the members named 'name'. Return false if any of them could not be read. */
+  bool loadNamedMembers(StringRef name);
+
+private:
+  typedef llvm::SmallVector<unsigned, 1> IndexList;
+  typedef llvm::StringMap<IndexList> NameIndexMap;
+
+  bool loadMember(unsigned index);
+
+  Module * module_;
+  NodeRef members_;
+  IterableScope * scope_;
+  Defn * parentDefn_;
+  StorageClass storage_;
+  NameIndexMap pending_;      // Operand indices of the members not yet created, by name
+  DefnList created_;          // Members which have been created, by operand index
+};
+
+MDMemberLoader::MDMemberLoader(Module * module, NodeRef members, IterableScope * scope,
+    Defn * parentDefn, StorageClass storage)
+  : module_(module)
+  , members_(members)
+  , scope_(scope)
+  , parentDefn_(parentDefn)
+  , storage_(storage)
+{
+  unsigned numOperands = members.size();
+  created_.resize(numOperands, NULL);
+  for (unsigned i = 0; i < numOperands; ++i) {
+    NodeRef node = members.nodeArg(i);
+    if (meta::Defn::Tag(node.intArg(MDReader::FIELD_DEFN_TYPE)) != meta::Defn::INVALID) {
+      pending_[node.strArg(MDReader::FIELD_DEFN_NAME)].push_back(i);
+    }
+  }
+}
+
+bool MDMemberLoader::loadNamedMembers(StringRef name) {
+  bool success = true;
+  NameIndexMap::iterator it = pending_.find(name);
+  if (it != pending_.end()) {
+    // Remove the entry before reading, in case reading the members looks up the name.
+    IndexList indices(it->second);
+    pending_.erase(it);
+    for (IndexList::const_iterator i = indices.begin(); i != indices.end(); ++i) {
+      success &= loadMember(*i);
+    }
+  }
+
+  return success;
+}
+
+void MDMemberLoader::loadAllMembers(DefnList & members) {
+  unsigned numOperands = members_.size();
+  for (unsigned i = 0; i < numOperands; ++i) {
+    NodeRef node = members_.nodeArg(i);
+    if (created_[i] == NULL &&
+        meta::Defn::Tag(node.intArg(MDReader::FIELD_DEFN_TYPE)) != meta::Defn::INVALID) {
+      loadMembers(node.strArg(MDReader::FIELD_DEFN_NAME));
+    }
+  }
+
+  for (DefnList::const_iterator it = created_.begin(); it != created_.end(); ++it) {
+    if (*it != NULL) {
+      members.push_back(*it);
+    }
+  }
+}
+
+bool MDMemberLoader::loadMember(unsigned index) {
+  created_[index] = MDReader(module_, parentDefn_).createMember(
+      members_.nodeArg(index), scope_, storage_);
+  return created_[index] != NULL;
 }
 
 // -------------------------------------------------------------------
@@ -131,33 +249,51 @@ bool MDReader::read(NamedMDNode * md) {
     return false;
   }
 
+  return readModule(
+      md->getOperand(FIELD_MODULE_VERSION),
+      md->getOperand(FIELD_MODULE_TIMESTAMP),
+      md->getOperand(FIELD_MODULE_IMPORTS),
+      md->getOperand(FIELD_MODULE_EXPORTS));
+}
+
+bool MDReader::read(NodeRef md) {
+  if (md.size() != 6) {
+    diag.fatal() << "Invalid number of MD operands " << md.size();
+    return false;
+  }
+
+  return readModule(
+      md.optNodeArg(FIELD_MODULE_VERSION),
+      md.optNodeArg(FIELD_MODULE_TIMESTAMP),
+      md.optNodeArg(FIELD_MODULE_IMPORTS),
+      md.optNodeArg(FIELD_MODULE_EXPORTS));
+}
+
+bool MDReader::readModule(NodeRef version, NodeRef timestamp, NodeRef imports,
+    NodeRef exports) {
   // Get the serialization format version.
-  if (ConstantInt * version = dyn_cast<ConstantInt>(
-      md->getOperand(FIELD_MODULE_VERSION)->getOperand(0))) {
-    version_ = (uint32_t) version->getValue().getZExtValue();
+  if (version.size() > 0) {
+    version_ = version.intArg(0);
   } else {
     diag.error() << "No version for compiled module " << module_->qualifiedName();
-    return NULL;
+    return false;
   }
 
   // Get the timestamp of the original source file.
-  if (MDNode * timestamp = dyn_cast<MDNode>(md->getOperand(FIELD_MODULE_TIMESTAMP))) {
-    (void)timestamp;
-    ///
-  } else {
+  if (timestamp.isNull()) {
     diag.error() << "No timestamp for compiled module " << module_->qualifiedName();
     return false;
   }
 
   // List of imports.
-  if (MDNode * imports = dyn_cast<MDNode>(md->getOperand(FIELD_MODULE_IMPORTS))) {
+  if (!imports.isNull()) {
     if (!readModuleImports(imports)) {
       return false;
     }
   }
 
   // List of exports.
-  if (MDNode * exports = dyn_cast<MDNode>(md->getOperand(FIELD_MODULE_EXPORTS))) {
+  if (!exports.isNull()) {
     module_->setMDNode(exports);
     return true;
   }
@@ -168,6 +304,7 @@ bool MDReader::read(NamedMDNode * md) {
 
 bool MDReader::readModuleImports(NodeRef node) {
   if (node.size() > 0) {
+    GCArena::Scope arenaScope(module_->astArena());
     ASTReader reader(module_->location(), module_->moduleStrings(), node.strArg(0));
     if (!reader.readAll(module_->imports())) {
       return false;
@@ -193,6 +330,7 @@ bool MDReader::readImports(Defn * de, ASTNodeList & imports) {
 
   StringRef str = importsNode.strArg(0);
   if (!str.empty()) {
+    GCArena::Scope arenaScope(module_->astArena());
     ASTReader reader(de->location(), module_->moduleStrings(), str);
     if (!reader.readAll(imports)) {
       return false;
@@ -205,7 +343,7 @@ bool MDReader::readImports(Defn * de, ASTNodeList & imports) {
 bool MDReader::readMembers(Defn * parentDefn) {
   NodeRef node(parentDefn->mdNode());
   NodeRef members;
-  Scope * memberScope;
+  IterableScope * memberScope;
   if (TypeDefn * tdef = dyn_cast<TypeDefn>(parentDefn)) {
     members = node.nodeArg(FIELD_TYPEDEF_MEMBERS);
     memberScope = tdef->typePtr()->mutableMemberScope();
@@ -225,39 +363,56 @@ bool MDReader::readMembers(Defn * parentDefn) {
   return readMembers(members, memberScope, parentDefn);
 }
 
-bool MDReader::readMembers(NodeRef members, Scope * scope, Defn * parentDefn) {
-  bool success = true;
-  unsigned numOperands = members.size();
+bool MDReader::readMembers(NodeRef members, IterableScope * scope, Defn * parentDefn) {
   StorageClass storage = Storage_Instance;
   if (parentDefn->defnType() == Defn::Mod || parentDefn->defnType() == Defn::Namespace) {
     storage = Storage_Global;
   }
-  Defn * savedSubject = setSubject(parentDefn);
+
+  MDMemberLoader * loader = new MDMemberLoader(module_, members, scope, parentDefn, storage);
+  scope->setMemberLoader(loader);
+
+  // The entry point has to be registered with the module even if nothing refers to it.
+  bool success = true;
+  unsigned numOperands = members.size();
   for (unsigned i = 0; i < numOperands; ++i) {
-    Defn * member = readMember(members.nodeArg(i), scope, storage);
-    if (member != NULL) {
-      scope->addMember(member);
-      member->setParentDefn(parentDefn);
-      member->createQualifiedName(parentDefn);
-      member->copyTrait(parentDefn, Defn::Synthetic);
-      if (parentDefn->hasUnboundTypeParams() || parentDefn->isTemplateMember()) {
-        member->addTrait(Defn::TemplateMember);
-      }
-      if (parentDefn->isPartialInstantiation()) {
-        member->addTrait(Defn::PartialInstantiation);
-      }
-      if (parentDefn->isSingular() && !member->isTemplate()) {
-        member->addTrait(Defn::Singular);
-      }
-    } else {
-      success = false;
+    NodeRef node = members.nodeArg(i);
+    if (meta::Defn::Tag(node.intArg(FIELD_DEFN_TYPE)) != meta::Defn::INVALID &&
+        (node.intArg(FIELD_DEFN_MODS) & meta::DefnFlag::ENTRY_POINT) != 0) {
+      success &= loader->loadNamedMembers(node.strArg(FIELD_DEFN_NAME));
     }
   }
 
-  setSubject(savedSubject);
   return success;
 }
 
+Defn * MDReader::createMember(NodeRef node, Scope * scope, StorageClass storage) {
+  Defn * parentDefn = subject_;
+  Defn * member = readMember(node, scope, storage);
+  if (member != NULL) {
+    scope->addMember(member);
+    member->setParentDefn(parentDefn);
+    member->createQualifiedName(parentDefn);
+    member->copyTrait(parentDefn, Defn::Synthetic);
+    if (parentDefn->hasUnboundTypeParams() || parentDefn->isTemplateMember()) {
+      member->addTrait(Defn::TemplateMember);
+    }
+    if (parentDefn->isPartialInstantiation()) {
+      member->addTrait(Defn::PartialInstantiation);
+    }
+    if (parentDefn->isSingular() && !member->isTemplate()) {
+      member->addTrait(Defn::Singular);
+    }
+  } else {
+    // Members are created when they are first looked up, so there is no caller to
+    // return the failure to; report it here rather than dropping the member silently.
+    diag.error(parentDefn) << "Unable to read definition of '" <<
+        node.strArg(FIELD_DEFN_NAME) << "' in compiled module " << module_->qualifiedName();
+  }
+
+  return member;
+}
+
 Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage) {
   diag.recovered();
 
@@ -347,7 +502,7 @@ Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage)
 
       tdef->setValue(ctype);
       tdef->setStorageClass(storage);
-      tdef->setMDNode(node.node());
+      tdef->setMDNode(node);
       return tdef;
     }
 
@@ -359,7 +514,7 @@ Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage)
       EnumType * etype = new EnumType(tdef, parent);
       tdef->setValue(etype);
       tdef->setStorageClass(storage);
-      tdef->setMDNode(node.node());
+      tdef->setMDNode(node);
 
       if (modifiers & meta::DefnFlag::FLAGS_ENUM) {
         etype->setIsFlags(true);
@@ -386,7 +541,7 @@ Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage)
       NamespaceDefn * ns = new NamespaceDefn(module_, module_->internString(name));
       ns->setLocation(location);
       ns->setVisibility(visibility);
-      ns->setMDNode(node.node());
+      ns->setMDNode(node);
       if (modifiers & meta::DefnFlag::REFLECTED) {
         ns->addTrait(Defn::Reflect);
       }
@@ -404,7 +559,7 @@ Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage)
       fn->setLocation(location);
       fn->setVisibility(visibility);
       fn->setStorageClass(storage);
-      fn->setMDNode(node.node());
+      fn->setMDNode(node);
 
 //      TemplateInstance * tinst_;  // Template arguments
 //      int dispatchIndex_;
@@ -481,7 +636,7 @@ Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage)
       prop->setLocation(location);
       prop->setVisibility(visibility);
       prop->setStorageClass(storage);
-      prop->setMDNode(node.node());
+      prop->setMDNode(node);
       return prop;
     }
 
@@ -490,7 +645,7 @@ Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage)
       idx->setLocation(location);
       idx->setVisibility(visibility);
       idx->setStorageClass(storage);
-      idx->setMDNode(node.node());
+      idx->setMDNode(node);
       return idx;
     }
 
@@ -501,7 +656,7 @@ Defn * MDReader::readMember(NodeRef node, Scope * parent, StorageClass storage)
       var->setLocation(location);
       var->setVisibility(visibility);
       var->setStorageClass(storage);
-      var->setMDNode(node.node());
+      var->setMDNode(node);
       const Type * type = readTypeRef(node.strArg(FIELD_VAR_TYPE));
       if (type == NULL) {
         return NULL;
@@ -612,7 +767,7 @@ bool MDReader::readEnumConstants(TypeDefn * tdef) {
   return true;
 }
 
-bool MDReader::readTypeMembers(TypeDefn * tdef, Scope * memberScope) {
+bool MDReader::readTypeMembers(TypeDefn * tdef, IterableScope * memberScope) {
   return readMembers(NodeRef(tdef->mdNode()).nodeArg(FIELD_TYPEDEF_MEMBERS), memberScope, tdef);
 }
 
@@ -656,6 +811,7 @@ const Stmt * MDReader::readFunctionBody(FunctionDefn * fn) {
     return NULL;
   }
   //diag.debug() << Format_QualifiedName << "Reading body for: " << fn;
+  GCArena::Scope arenaScope(module_->astArena());
   ASTReader reader(fn->location(), module_->moduleStrings(), astStr);
   return cast_or_null<Stmt>(reader.read());
 }
@@ -695,6 +851,7 @@ bool MDReader::readAccessorList(PropertyDefn * prop, NodeRef node) {
 
 ASTTemplate * MDReader::readTemplate(SourceLocation loc, StringRef source,
     StringRef name) {
+  GCArena::Scope arenaScope(module_->astArena());
   ASTReader reader(loc, module_->moduleStrings(), source);
   ASTNode * ast = reader.read();
   if (ast == NULL) {
@@ -737,7 +894,7 @@ Expr * MDReader::readExpression(SourceLocation loc, NodeRef node) {
       if (ty == NULL) {
         return NULL;
       }
-      ConstantInt * cint = cast<ConstantInt>(node.arg(2));
+      ConstantInt * cint = node.constIntArg(2);
       return new ConstantInteger(loc, ty, cint);
     }
 
@@ -759,11 +916,11 @@ Expr * MDReader::readExpression(SourceLocation loc, NodeRef node) {
         unsigned count = node.size() - 2;
         DASSERT(count == (unsigned) ctype->instanceFieldCountRecursive());
         for (unsigned i = 0; i < count; ++i) {
-          Value * v = node.arg(i + 2);
-          if (v == NULL) {
+          NodeRef member = node.optNodeArg(i + 2);
+          if (member.isNull()) {
             cobj->members()[i] = NULL;
           } else {
-            Expr * e = readExpression(loc, cast<MDNode>(v));
+            Expr * e = readExpression(loc, member);
             if (e == NULL) {
               return &Expr::ErrorVal;
             }
@@ -808,8 +965,13 @@ const Type * MDReader::readTypeRef(StringRef str) {
     return NULL;
   }
 
-  ASTReader reader(module_->location(), module_->moduleStrings(), str);
-  ASTNode * ast = reader.read();
+  ASTNode * ast;
+  {
+    GCArena::Scope arenaScope(module_->astArena());
+    ASTReader reader(module_->location(), module_->moduleStrings(), str);
+    ast = reader.read();
+  }
+
   TypeAnalyzer ta(module_, module_);
   ta.setSubject(subject_);
   return ta.typeFromAST(ast);
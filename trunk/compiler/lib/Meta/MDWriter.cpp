@@ -355,7 +355,9 @@ MDNode * MDWriter::location(const Defn * de) {
     builder.put(tagValue(pos.beginCol));
     builder.put(tagValue(pos.endLine));
     builder.put(tagValue(pos.endCol));
-    return builder.build();
+    MDNode * node = builder.build();
+    locations_.insert(node);
+    return node;
   }
 
   return NULL;
@@ -78,6 +78,7 @@ SystemClass Builtins::typeIntrinsicAttribute("tart.annex.Intrinsic");
 SystemClass Builtins::typeStaticRoot("tart.gc.StaticRoot");
 SystemClass Builtins::typeTraceAction("tart.gc.TraceAction");
 SystemClass Builtins::typeTraceDescriptor("tart.gc.TraceDescriptor");
+SystemClass Builtins::typeAllocContext("tart.gc.AllocContext");
 
 SystemClass Builtins::typeRef("tart.core.Ref");
 SystemClass Builtins::typeValueRef("tart.core.ValueRef");
@@ -180,6 +181,7 @@ void Builtins::loadSystemClasses() {
   typeStaticRoot.get();
   typeTraceAction.get();
   typeTraceDescriptor.get();
+  typeAllocContext.get();
 
   // Analyze class Object.
   AnalyzerBase::analyzeType(typeObject.get(), Task_PrepMemberLookup);
@@ -628,6 +628,12 @@ Value * ArrayCopyIntrinsic::generate(CodeGenerator & cg, const FnCallExpr * call
   args[3] = cg.getInt32Val(0); // TODO: Better alignment
   args[4] = llvm::ConstantInt::getFalse(cg.context()); // TODO: isVolatile
 
+  // Copying references may store pointers to young objects into an older one, and
+  // overwrites references which incremental marking must still see.
+  if (elemType->containsReferenceType()) {
+    cg.genWriteBarrierRange(elemType.unqualified(), args[0], length);
+  }
+
   return cg.builder().CreateCall(intrinsic, args);
 }
 
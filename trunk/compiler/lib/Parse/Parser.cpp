@@ -145,6 +145,7 @@ void Parser::skipToRParen() {
 
 bool Parser::parse() {
   int errorCount = diag.getErrorCount();
+  GCArena::Scope arenaScope(module->astArena());
 
   // Parse imports
   parseImports(module->imports());
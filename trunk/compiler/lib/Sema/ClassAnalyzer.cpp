@@ -356,7 +356,7 @@ bool ClassAnalyzer::analyzeBaseClassesImpl() {
   // internally by the compiler, in which case the compiler is responsible
   // for setting up the base class list correctly.
   const ASTTypeDecl * ast = cast_or_null<const ASTTypeDecl>(target->ast());
-  if (ast == NULL && target->mdNode() == NULL) {
+  if (ast == NULL && target->mdNode().isNull()) {
     return true;
   }
 
@@ -387,7 +387,7 @@ bool ClassAnalyzer::analyzeBaseClassesImpl() {
   ta.setActiveScope(type->mutableMemberScope());
 
   TypeList bases;
-  if (target->mdNode() != NULL) {
+  if (!target->mdNode().isNull()) {
     if (!MDReader(module_, target).readCompositeDetails(type, bases)) {
       return false;
     }
@@ -533,7 +533,7 @@ bool ClassAnalyzer::analyzeImports() {
     if (trace_) {
       diag.debug() << "Imports";
     }
-    if (target->mdNode() != NULL) {
+    if (!target->mdNode().isNull()) {
       ASTNodeList imports;
       if (MDReader(module_, target).readImports(target, imports)) {
         analyzeImportsImpl(imports);
@@ -1628,7 +1628,7 @@ bool ClassAnalyzer::analyzeCompletely() {
 
     for (Defn * member = type->firstMember(); member != NULL; member = member->nextInScope()) {
       // No need to completely analyze imported functions.
-      if (member->defnType() == Defn::Function && member->mdNode() != NULL) {
+      if (member->defnType() == Defn::Function && !member->mdNode().isNull()) {
         continue;
       }
       AnalyzerBase::analyzeCompletely(member);
@@ -31,6 +31,7 @@
 #include "tart/Sema/ExprAnalyzer.h"
 #include "tart/Sema/ScopeBuilder.h"
 #include "tart/Sema/FindExternalRefsPass.h"
+#include "tart/Sema/EscapeAnalysisPass.h"
 #include "tart/Sema/EvalPass.h"
 
 #include "tart/Objects/Builtins.h"
@@ -108,6 +109,7 @@ bool DefnAnalyzer::analyzeModule() {
   analyzeType(Builtins::typeTypeInfoBlock.get(), Task_PrepCodeGeneration);
   analyzeType(Builtins::typeTraceAction.get(), Task_PrepConstruction);
   analyzeType(Builtins::typeStaticRoot.get(), Task_PrepConstruction);
+  analyzeType(Builtins::typeAllocContext.get(), Task_PrepConstruction);
   if (Builtins::funcTypecastError != NULL) {
     analyzeFunction(Builtins::funcTypecastError, Task_PrepTypeGeneration);
     analyzeFunction(Builtins::funcTypecastErrorExt, Task_PrepTypeGeneration);
@@ -148,6 +150,19 @@ bool DefnAnalyzer::analyzeModule() {
     }
   }
 
+  // Now that the bodies of all of the functions in the module are known, find the
+  // allocations which can be placed on the stack.
+  if (success) {
+    DefnSet & xdefs = module_->exportDefs();
+    for (DefnSet::iterator it = xdefs.begin(); it != xdefs.end(); ++it) {
+      if (FunctionDefn * fn = dyn_cast<FunctionDefn>(*it)) {
+        if (!fn->isTemplate()) {
+          EscapeAnalysisPass::run(fn);
+        }
+      }
+    }
+  }
+
   // Prevent further symbols from being added.
   module_->passes().finish(Module::CompletionPass);
   return success;
@@ -155,7 +170,7 @@ bool DefnAnalyzer::analyzeModule() {
 
 bool DefnAnalyzer::createMembersFromAST(Defn * in) {
   // Create members of this scope.
-  if (in->ast() != NULL || in->mdNode() != NULL) {
+  if (in->ast() != NULL || !in->mdNode().isNull()) {
     ScopeBuilder::createScopeMembers(in);
   }
 
@@ -172,7 +187,7 @@ bool DefnAnalyzer::resolveAttributes(Defn * in) {
     return true;
   }
 
-  if (in->mdNode() != NULL) {
+  if (!in->mdNode().isNull()) {
     if (!MDReader(module_, in).readAttributeList(in)) {
       return false;
     }
@@ -437,7 +452,7 @@ void DefnAnalyzer::analyzeTemplateSignature(Defn * de) {
   Template * tm = de->templateSignature();
   DASSERT_OBJ(tm != NULL, de);
 
-  if (de->mdNode() != NULL && tm->ast() == NULL) {
+  if (!de->mdNode().isNull() && tm->ast() == NULL) {
     // Create definitions from Metadata Node.
     MDReader(de->module(), de).readMembers(de);
   }
@@ -247,7 +247,7 @@ bool EnumAnalyzer::runPasses(EnumType::PassSet passesToRun) {
       // Don't evaluate the attributes if the enclosing class is Attribute, because that creates
       // a circular dependency. For now, assume that any Enum defined within Attribute that has
       // any attributes at all is a Flags enum.
-      if (target_->mdNode() == NULL && !target_->ast()->attributes().empty()) {
+      if (target_->mdNode().isNull() && !target_->ast()->attributes().empty()) {
         type->setIsFlags(true);
       }
     } else if (type->passes().begin(EnumType::AttributePass)) {
@@ -290,7 +290,7 @@ bool EnumAnalyzer::analyzeBase() {
   // Analyze the base type of the enum.
   intValueType_ = &Int32Type::instance;
 
-  if (target_->mdNode() != NULL) {
+  if (!target_->mdNode().isNull()) {
     // Read the base type from the metadata
     const Type * base = MDReader(module_, target_).readEnumBase(target_);
     if (base != NULL) {
@@ -324,7 +324,7 @@ bool EnumAnalyzer::createMembers() {
   // Mark as finished so that we don't recurse when referring to members.
   enumType->passes().finish(EnumType::ScopeCreationPass);
 
-  if (target_->mdNode() != NULL) {
+  if (!target_->mdNode().isNull()) {
     if (!MDReader(module_, target_).readEnumConstants(target_)) {
       success = false;
     }
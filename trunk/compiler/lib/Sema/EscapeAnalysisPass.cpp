@@ -0,0 +1,186 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include "tart/Expr/Exprs.h"
+#include "tart/Expr/StmtExprs.h"
+#include "tart/Type/FunctionType.h"
+#include "tart/Defn/FunctionDefn.h"
+
+#include "tart/Sema/EscapeAnalysisPass.h"
+
+#include "tart/Common/Diagnostics.h"
+
+#include "llvm/Support/CommandLine.h"
+
+namespace tart {
+
+static llvm::cl::opt<bool>
+DisableStackAlloc("disable-stack-alloc",
+    llvm::cl::desc("Allocate all objects on the heap, even if they don't escape"));
+
+/// -------------------------------------------------------------------
+/// EscapeAnalysisPass
+
+void EscapeAnalysisPass::run(FunctionDefn * in) {
+  if (DisableStackAlloc || !canAnalyze(in)) {
+    return;
+  }
+
+  // The first pass finds the local variables which hold new objects. The second pass
+  // looks at every use of those variables.
+  EscapeAnalysisPass instance;
+  instance.visitExpr(in->body());
+  if (instance.tracked_.empty()) {
+    return;
+  }
+
+  instance.visitExpr(in->body());
+  for (AllocMap::const_iterator it = instance.allocs_.begin(); it != instance.allocs_.end();
+      ++it) {
+    if (!instance.escaped_.count(it->first)) {
+      it->second->setStackAlloc(true);
+      const_cast<VariableDefn *>(it->first)->setFlag(VariableDefn::StackObject);
+    }
+  }
+}
+
+bool EscapeAnalysisPass::isSelfNoEscape(FunctionDefn * fn) {
+  if ((fn->flags() & FunctionDefn::EscapeAnalyzed) == 0) {
+    // Mark the function as analyzed first, so that recursive calls are treated as
+    // letting 'self' escape.
+    fn->setFlag(FunctionDefn::EscapeAnalyzed);
+    ParameterDefn * selfParam = fn->functionType()->selfParam();
+    if (fn->storageClass() == Storage_Instance && selfParam != NULL && canAnalyze(fn)) {
+      EscapeAnalysisPass instance;
+      instance.tracked_.insert(selfParam);
+      instance.visitExpr(fn->body());
+      if (!instance.escaped_.count(selfParam)) {
+        fn->setFlag(FunctionDefn::SelfNoEscape);
+      }
+    }
+  }
+
+  return fn->isSelfNoEscape();
+}
+
+bool EscapeAnalysisPass::canAnalyze(const FunctionDefn * fn) {
+  // Closures capture the values of local variables without referring to them in
+  // the body of the function, so don't try to track variables in their presence.
+  return fn->body() != NULL && !fn->isIntrinsic() && !fn->isExtern() &&
+      fn->closureEnvs().empty();
+}
+
+const VariableDefn * EscapeAnalysisPass::trackedVar(const Expr * in) const {
+  if (const LValueExpr * lval = dyn_cast<LValueExpr>(in)) {
+    if (lval->base() == NULL) {
+      if (const VariableDefn * var = dyn_cast<VariableDefn>(lval->value())) {
+        if (tracked_.count(var)) {
+          return var;
+        }
+      }
+    }
+  }
+
+  return NULL;
+}
+
+const VariableDefn * EscapeAnalysisPass::trackedOwner(const Expr * in) const {
+  // Walk outwards through fields and elements which are embedded in their container.
+  // A reference-typed container is a separate object, so the search stops there.
+  for (;;) {
+    if (const VariableDefn * var = trackedVar(in)) {
+      return var;
+    }
+
+    const Expr * base;
+    if (const LValueExpr * lval = dyn_cast<LValueExpr>(in)) {
+      base = lval->base();
+    } else if (in->exprType() == Expr::ElementRef) {
+      base = static_cast<const BinaryExpr *>(in)->first();
+    } else {
+      return NULL;
+    }
+
+    if (base == NULL) {
+      return NULL;
+    } else if (base->canonicalType()->isReferenceType()) {
+      return trackedVar(base);
+    }
+
+    in = base;
+  }
+}
+
+Expr * EscapeAnalysisPass::visitInitVar(InitVarExpr * in) {
+  // Look for 'let v = T(...)', where the constructor of T doesn't retain 'self'.
+  VariableDefn * var = in->var();
+  if (var->storageClass() == Storage_Local && !var->isSharedRef() && !var->isAssignedTo() &&
+      !tracked_.count(var)) {
+    if (FnCallExpr * call = dyn_cast<FnCallExpr>(in->initExpr())) {
+      NewExpr * newExpr = dyn_cast_or_null<NewExpr>(call->selfArg());
+      if (call->exprType() == Expr::CtorCall && newExpr != NULL &&
+          newExpr->type()->typeClass() == Type::Class && isSelfNoEscape(call->function())) {
+        tracked_.insert(var);
+        allocs_[var] = newExpr;
+      }
+    }
+  }
+
+  return CFGPass::visitInitVar(in);
+}
+
+Expr * EscapeAnalysisPass::visitLValue(LValueExpr * in) {
+  if (const VariableDefn * var = trackedVar(in)) {
+    if (!safeUses_.count(in)) {
+      escaped_.insert(var);
+    }
+  } else if (in->base() != NULL && trackedVar(in->base()) != NULL) {
+    // Loading or storing a field doesn't let the object itself escape.
+    if (in->value()->storageClass() == Storage_Instance && isa<VariableDefn>(in->value())) {
+      safeUses_.insert(in->base());
+    }
+  }
+
+  return CFGPass::visitLValue(in);
+}
+
+Expr * EscapeAnalysisPass::visitFnCall(FnCallExpr * in) {
+  Expr * self = in->selfArg();
+  while (self != NULL &&
+      (self->exprType() == Expr::UpCast || self->exprType() == Expr::QualCast)) {
+    self = static_cast<CastExpr *>(self)->arg();
+  }
+
+  if (self != NULL && trackedVar(self) != NULL && in->exprType() == Expr::FnCall &&
+      isSelfNoEscape(in->function())) {
+    safeUses_.insert(self);
+  }
+
+  // The address of a field is a pointer into the object, which would dangle once the
+  // frame of a stack-allocated object was gone.
+  FunctionDefn * fn = in->function();
+  if (fn != NULL && fn->isIntrinsic() && fn->qualifiedName() == "tart.core.Memory.addressOf") {
+    for (ExprList::const_iterator it = in->args().begin(); it != in->args().end(); ++it) {
+      if (const VariableDefn * var = trackedOwner(*it)) {
+        escaped_.insert(var);
+      }
+    }
+  }
+
+  return CFGPass::visitFnCall(in);
+}
+
+Expr * EscapeAnalysisPass::visitRefEq(BinaryExpr * in) {
+  if (trackedVar(in->first()) != NULL) {
+    safeUses_.insert(in->first());
+  }
+
+  if (trackedVar(in->second()) != NULL) {
+    safeUses_.insert(in->second());
+  }
+
+  return CFGPass::visitRefEq(in);
+}
+
+} // namespace tart
@@ -78,6 +78,8 @@ Expr * ExprAnalyzer::reduceBoolLiteral(const ASTBoolLiteral * ast) {
 Expr * ExprAnalyzer::reduceBuiltInDefn(const ASTBuiltIn * ast) {
   if (TypeDefn * tdef = dyn_cast<TypeDefn>(ast->value())) {
     return tdef->asExpr();
+  } else if (VariableDefn * var = dyn_cast<VariableDefn>(ast->value())) {
+    return LValueExpr::get(ast->location(), NULL, var);
   } else {
     DFAIL("Implement");
   }
@@ -7,6 +7,7 @@
 #include "tart/Defn/FunctionDefn.h"
 #include "tart/Defn/Module.h"
 #include "tart/Defn/PropertyDefn.h"
+#include "tart/Defn/Template.h"
 #include "tart/Defn/TypeDefn.h"
 
 #include "tart/Expr/Exprs.h"
@@ -260,6 +261,15 @@ Expr * ExprAnalyzer::reduceForEachStmt(const ForEachStmt * st, QualifiedType exp
 
   Qualified<CompositeType> iterType = iteratorExpr->type().as<CompositeType>();
   AnalyzerBase::analyzeType(iterType.unqualified(), Task_PrepMemberLookup);
+
+  // Arrays and ArrayLists are iterated by index, which avoids allocating an iterator and
+  // calling it through an interface for every element.
+  if (st->loopVars()->nodeType() == ASTNode::Var && isIndexedCollection(iterType.unqualified())) {
+    Expr * result = reduceIndexedForEach(st, iteratorExpr, forScope);
+    setActiveScope(savedScope);
+    return result;
+  }
+
   FunctionDefn * nextFn = findInterfaceMethod(
       iterType.unqualified(), Builtins::typeIterator, "next");
   if (nextFn == NULL) {
@@ -388,6 +398,81 @@ Expr * ExprAnalyzer::reduceForEachStmt(const ForEachStmt * st, QualifiedType exp
   return foreach;
 }
 
+bool ExprAnalyzer::isIndexedCollection(const CompositeType * type) {
+  TypeDefn * tdef = type->typeDefn();
+  if (tdef == NULL || tdef->templateInstance() == NULL) {
+    return false;
+  }
+
+  // Both classes are final, so the 'size' and indexer calls can't be overridden.
+  Defn * tmpl = tdef->templateInstance()->templateDefn();
+  return tmpl == Builtins::typeArray->typeDefn() ||
+      tmpl->qualifiedName() == "tart.collections.ArrayList";
+}
+
+Expr * ExprAnalyzer::reduceIndexedForEach(const ForEachStmt * st, Expr * collExpr,
+    LocalScope * forScope) {
+  SourceLocation stLoc = st->location();
+  SourceLocation collLoc = collExpr->location();
+
+  // let foreach.coll = <collection>; var foreach.index = 0
+  VariableDefn * collVar = createTempVar(collLoc, Defn::Let, collExpr->type(), "foreach.coll");
+  VariableDefn * indexVar = createTempVar(
+      collLoc, Defn::Var, &Int32Type::instance, "foreach.index");
+  Expr * initExpr = new BinaryExpr(Expr::Prog2, collLoc, &Int32Type::instance,
+      new InitVarExpr(collLoc, collVar, collExpr),
+      new InitVarExpr(collLoc, indexVar, ConstantInteger::getSInt32(0)));
+
+  // The remaining expressions are built as AST so that the usual overload resolution
+  // picks the 'size' property and the indexer. The size is re-read on each iteration,
+  // in the same way as the iterator does.
+  ASTNode * collRef = new ASTBuiltIn(collVar);
+  ASTNode * indexRef = new ASTBuiltIn(indexVar);
+
+  ASTNodeList testArgs;
+  testArgs.push_back(indexRef);
+  testArgs.push_back(new ASTMemberRef(collLoc, collRef, "size"));
+  Expr * testExpr = inferTypes(
+      reduceExpr(new ASTCall(collLoc, &ASTIdent::operatorLT, testArgs), &BoolType::instance),
+      &BoolType::instance);
+  CHECK_EXPR(testExpr);
+
+  ASTNodeList succArgs;
+  succArgs.push_back(indexRef);
+  ASTNode * succCall = new ASTCall(collLoc, &ASTIdent::operatorSucc, succArgs);
+  Expr * incrExpr = inferTypes(reduceExpr(new ASTOper(ASTNode::Assign, indexRef, succCall),
+      NULL), NULL);
+  CHECK_EXPR(incrExpr);
+
+  ASTOper * elementRef = new ASTOper(ASTNode::GetElement, collLoc);
+  elementRef->append(collRef);
+  elementRef->append(indexRef);
+
+  const ASTVarDecl * varDecl = static_cast<const ASTVarDecl *>(st->loopVars());
+  VariableDefn * loopVar = cast<VariableDefn>(astToDefn(varDecl));
+  Expr * elementExpr = inferTypes(reduceExpr(elementRef, loopVar->type()), loopVar->type());
+  CHECK_EXPR(elementExpr);
+  if (!loopVar->type()) {
+    loopVar->setType(elementExpr->type());
+  }
+
+  if (!analyzeVariable(loopVar, Task_PrepTypeGeneration)) {
+    return &Expr::ErrorVal;
+  }
+
+  elementExpr = loopVar->type()->implicitCast(stLoc, elementExpr);
+  CHECK_EXPR(elementExpr);
+
+  Expr * bodyExpr = reduceExpr(st->body(), NULL);
+  CHECK_EXPR(bodyExpr);
+
+  SeqExpr * body = new SeqExpr(stLoc, &VoidType::instance);
+  body->appendArg(new InitVarExpr(stLoc, loopVar, elementExpr));
+  body->appendArg(bodyExpr);
+
+  return new ForExpr(stLoc, forScope, initExpr, testExpr, incrExpr, body);
+}
+
 Expr * ExprAnalyzer::reduceSwitchStmt(const SwitchStmt * st, QualifiedType expected) {
   Scope * savedScope = activeScope();
   Scope * caseValScope = activeScope();
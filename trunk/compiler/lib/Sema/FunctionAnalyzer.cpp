@@ -324,7 +324,7 @@ bool FunctionAnalyzer::resolveParameterTypes() {
       diag.debug(target) << Format_Type << "Analyzing parameter types for " << target;
     }
 
-    if (target->mdNode() != NULL) {
+    if (!target->mdNode().isNull()) {
       if (!MDReader(module_, target).readFunctionType(target)) {
         return false;
       }
@@ -461,11 +461,17 @@ bool FunctionAnalyzer::createCFG() {
       const Stmt * astBody = NULL;
       if (target->functionDecl() != NULL) {
         astBody = target->functionDecl()->body();
-      } else if (target->mdNode() != NULL) {
+      } else if (!target->mdNode().isNull()) {
         astBody = MDReader(module_, target).readFunctionBody(target);
       }
 
       if (astBody != NULL) {
+        // The call candidates, constraints and type assignments created while analyzing
+        // the body are only needed until its types are final, so they are allocated
+        // together and freed as a unit.
+        GCArena * temps = new GCArena();
+        GCArena::Scope arenaScope(temps);
+
         StmtAnalyzer sa(target, astBody);
         success = sa.buildCFG();
         if (success) {
@@ -482,6 +488,8 @@ bool FunctionAnalyzer::createCFG() {
             visitClosureEnvs(target->closureEnvs());
           }
         }
+
+        temps->release();
       }
     }
 
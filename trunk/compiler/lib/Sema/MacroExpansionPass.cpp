@@ -95,7 +95,7 @@ Expr * MacroExpansionPass::visitFnCall(FnCallExpr * in) {
     const Stmt * macroBody;
     if (macro->ast() != NULL) {
       macroBody = macro->functionDecl()->body();
-    } else if (macro->mdNode() != NULL) {
+    } else if (!macro->mdNode().isNull()) {
       macroBody = MDReader(macro->module(), macro).readFunctionBody(macro);
       if (macroBody == NULL) {
         return &Expr::ErrorVal;
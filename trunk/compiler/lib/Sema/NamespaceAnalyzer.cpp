@@ -82,7 +82,7 @@ bool NamespaceAnalyzer::runPasses(NamespaceDefn::PassSet passesToRun) {
 
 bool NamespaceAnalyzer::analyzeImports() {
   if (target->passes().begin(NamespaceDefn::ImportPass)) {
-    if (target->mdNode() != NULL) {
+    if (!target->mdNode().isNull()) {
       ASTNodeList imports;
       if (MDReader(module_, target).readImports(target, imports)) {
         analyzeImportsImpl(imports);
@@ -91,7 +91,7 @@ bool PropertyAnalyzer::runPasses(PropertyDefn::PassSet passesToRun) {
 
   if (passesToRun.contains(PropertyDefn::AccessorCreationPass) &&
       target->passes().begin(PropertyDefn::AccessorCreationPass)) {
-    if (target->mdNode() != NULL) {
+    if (!target->mdNode().isNull()) {
       if (!MDReader(module_, target).readPropertyAccessors(target)) {
         return false;
       }
@@ -141,7 +141,7 @@ bool PropertyAnalyzer::resolvePropertyType() {
     // Evaluate the explicitly declared type, if any
     QualifiedType type = target->type();
     if (type.isNull()) {
-      if (target->mdNode() != NULL) {
+      if (!target->mdNode().isNull()) {
         if (!MDReader(module_, target).readPropertyType(target)) {
           return false;
         }
@@ -26,7 +26,7 @@ namespace tart {
 typedef ASTDeclList::const_iterator decl_iterator;
 
 void ScopeBuilder::createScopeMembers(Defn * parent) {
-  if (parent->mdNode()) {
+  if (!parent->mdNode().isNull()) {
     // Create definitions from Metadata Node.
     MDReader(parent->module(), parent).readMembers(parent);
   } else {
@@ -0,0 +1,15 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+/* Card table parameters shared by the inline write barrier that the linker emits and the
+   runtime library. The collector in tart.gc.heap.CardTable passes its own card size to
+   GC_setCardTable, which checks it against this one. */
+
+#ifndef TART_GC_CARDTABLE_H
+#define TART_GC_CARDTABLE_H
+
+/** Log2 of the number of heap bytes covered by each card. */
+#define TART_CARD_SHIFT 9
+
+#endif // TART_GC_CARDTABLE_H
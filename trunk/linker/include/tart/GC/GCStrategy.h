@@ -98,12 +98,35 @@ public:
     InitRoots = false;
     CustomRoots = true;
     UsesMetadata = true;
+    CustomWriteBarriers = true;
     NeededSafePoints = 1 << GC::PostCall;
   }
 
   bool performCustomLowering(llvm::Function &F);
   bool insertRootInitializers(llvm::Function & fn, llvm::AllocaInst ** roots, unsigned count);
   bool couldBecomeSafePoint(llvm::Instruction * inst);
+
+  /** Compute the liveness of the GC roots at each safe point. Roots which are never live
+      across a safe point are removed from the stack map and promoted to registers, and
+      roots whose live ranges don't overlap are merged into a single stack slot. */
+  bool optimizeRoots(llvm::Function & fn, llvm::ArrayRef<llvm::AllocaInst *> roots);
+
+  /** Insert polls of the safepoint flag at every loop back-edge, and on entry to any
+      function which makes calls, so that a thread can always be stopped promptly. */
+  bool insertSafepointPolls(llvm::Function & fn);
+
+  /** Replace each llvm.gcwrite call with a store, preceded by a call to the write
+      barrier if incremental marking is in progress, and followed by a card mark. */
+  bool lowerWriteBarriers(llvm::Function & fn, llvm::ArrayRef<llvm::CallInst *> writes);
+
+  /** Insert code immediately before 'inst' which marks the card containing 'slot' as
+      dirty, if it lies within the heap covered by the card table. */
+  void insertCardMark(llvm::Instruction * inst, llvm::Value * slot);
+
+  /** Insert a test of the i32 global 'flag' immediately before 'inst', splitting its
+      basic block, which calls 'callee' with 'args' if the flag is non-zero. */
+  void insertFlaggedCall(llvm::Instruction * inst, llvm::Constant * flag,
+      llvm::Constant * callee, llvm::ArrayRef<llvm::Value *> args, llvm::StringRef prefix);
 };
 
 class TartGCPrinter : public llvm::GCMetadataPrinter {
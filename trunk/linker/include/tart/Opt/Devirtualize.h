@@ -0,0 +1,80 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_OPT_DEVIRTUALIZE_H
+#define TART_OPT_DEVIRTUALIZE_H
+
+#include "llvm/Pass.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+
+namespace tart {
+using namespace llvm;
+
+/** Whole-program devirtualization pass.
+
+    When linking an executable, every class in the program is known, so the class hierarchy
+    can be reconstructed from the TypeInfoBlocks. Any virtual or interface call for which
+    only one method could be selected is replaced by a direct call to that method, which
+    allows it to be inlined.
+
+    The compiler marks each method lookup with 'tart.vcall' or 'tart.icall' metadata naming
+    the TIB of the class or interface and the method index. Interface lookups also mark
+    the comparisons which guard their fast paths with 'tart.icall.guard', so that once the
+    result is known the slow paths can be removed by the usual CFG simplification.
+
+    A virtual call is resolved either because no subclass of the receiver's static class
+    overrides the method (which is always the case for a final class), or because the TIB
+    it loads the method from is a constant, so the receiver's exact class is known. */
+class Devirtualize : public ModulePass {
+public:
+  static char ID;
+
+  Devirtualize() : ModulePass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage & AU) const;
+  bool runOnModule(Module & module);
+
+private:
+  /** Information about the TypeInfoBlock of a class. */
+  struct ClassInfo {
+    GlobalVariable * tib;
+    int depth;
+    const Constant * display;
+    const Constant * bases;
+    const Constant * itable;
+    const Constant * methods;
+  };
+
+  typedef SmallVector<ClassInfo, 64> ClassList;
+
+  /** Find the TIBs of all of the classes in the module. Returns false if there is a class
+      whose TIB is not defined in the module, in which case the hierarchy is not closed. */
+  bool findClasses(Module & module);
+
+  /** Return the method that virtual 'lookup' selects if the TIB it reads is a constant,
+      so that the exact class of the receiver is known; otherwise NULL. */
+  Constant * resolveExact(Instruction * lookup, const MDNode * info);
+
+  /** Return the single method which a lookup described by 'info' can return, or NULL if
+      there is more than one. */
+  Constant * resolveVirtual(const MDNode * info);
+  Constant * resolveInterface(Module & module, const MDNode * info);
+
+  /** Return the method at 'index' in method table 'methods', or NULL if there is none. */
+  static Constant * methodAt(const Constant * methods, unsigned index);
+
+  /** Return the method table for interface 'iname' in 'itable', or NULL. */
+  static const Constant * findInterface(const Constant * itable, const Value * iname);
+
+  ClassList classes_;
+  StringMap<ClassInfo *> classMap_;
+  bool hasProxies_;
+};
+
+}
+
+#endif
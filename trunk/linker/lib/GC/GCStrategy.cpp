@@ -3,7 +3,11 @@
  * ================================================================ */
 
 #include "tart/GC/GCStrategy.h"
+#include "tart/GC/CardTable.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/Dominators.h"
 #include "llvm/Function.h"
 #include "llvm/Target/Mangler.h"
 #include "llvm/Target/TargetMachine.h"
@@ -14,7 +18,12 @@
 #include "llvm/GlobalVariable.h"
 #include "llvm/Constants.h"
 #include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Module.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 
 #include <stdio.h>
 
@@ -24,6 +33,16 @@ using namespace llvm;
 
 typedef llvm::SmallVector<std::pair<MCSymbol *, MCSymbol *>, 64> SafePointList;
 
+/** The safe points of a single function, which the runtime looks up by address range. */
+struct FunctionSafePoints {
+  MCSymbol * startLabel;
+  MCSymbol * endLabel;
+  size_t count;
+  MCSymbol * tableLabel;
+};
+
+typedef llvm::SmallVector<FunctionSafePoints, 64> FunctionSafePointList;
+
 GCRegistry::Add<TartGCStrategy>
 AddTartGC("tart-gc", "Tart garbage collector.");
 
@@ -33,6 +52,9 @@ AddTartGCPrinter("tart-gc", "Tart garbage collector.");
 //cl::opt<bool> optShowGC("show-gc",
 //    cl::desc("Print debugging output from GC strategy"));
 
+static cl::opt<bool> optNoRootLiveness("disable-gc-root-liveness",
+    cl::desc("Keep every GC root in the stack map for the whole function"));
+
 void addTartGC() {}
 
 // -------------------------------------------------------------------
@@ -41,6 +63,7 @@ void addTartGC() {}
 bool TartGCStrategy::performCustomLowering(Function & fn) {
   bool madeChange = false;
   SmallVector<AllocaInst*, 32> roots;
+  SmallVector<CallInst*, 32> writes;
 
   for (Function::iterator bb = fn.begin(), bbEnd = fn.end(); bb != bbEnd; ++bb) {
     for (BasicBlock::iterator II = bb->begin(), E = bb->end(); II != E; ) {
@@ -48,9 +71,8 @@ bool TartGCStrategy::performCustomLowering(Function & fn) {
         if (Function * F = CI->getCalledFunction()) {
           switch (F->getIntrinsicID()) {
           case Intrinsic::gcwrite:
-            // Handle llvm.gcwrite.
-            //CI->eraseFromParent();
-            //MadeChange = true;
+            // Lowered below, since lowering splits the block.
+            writes.push_back(CI);
             break;
           case Intrinsic::gcread:
             // Handle llvm.gcread.
@@ -74,6 +96,18 @@ bool TartGCStrategy::performCustomLowering(Function & fn) {
     madeChange |= insertRootInitializers(fn, roots.begin(), roots.size());
   }
 
+  if (writes.size()) {
+    madeChange |= lowerWriteBarriers(fn, writes);
+  }
+
+  // Polls must come after the root initializers, since a poll may trace the stack.
+  madeChange |= insertSafepointPolls(fn);
+
+  // Root liveness is computed last, since the polls and write barriers are safe points.
+  if (roots.size() && !optNoRootLiveness) {
+    madeChange |= optimizeRoots(fn, roots);
+  }
+
   return madeChange;
 }
 
@@ -115,6 +149,371 @@ bool TartGCStrategy::insertRootInitializers(Function & fn, AllocaInst ** roots,
   return madeChange;
 }
 
+namespace {
+
+/// A root holding a single object reference, which is only ever loaded and stored.
+struct SimpleRoot {
+  AllocaInst * alloca;
+  IntrinsicInst * marker;   // The llvm.gcroot call.
+  Instruction * cast;       // The pointer cast passed to the marker, if any.
+};
+
+/// Per-block liveness of the simple roots.
+struct BlockLiveness {
+  BitVector use;            // Roots loaded before being stored in the block.
+  BitVector def;            // Roots stored in the block.
+  BitVector liveIn;
+  BitVector liveOut;
+};
+
+bool isGCRootMarker(Value * value) {
+  if (IntrinsicInst * ii = dyn_cast<IntrinsicInst>(value)) {
+    return ii->getIntrinsicID() == Intrinsic::gcroot;
+  }
+
+  return false;
+}
+
+/// If 'root' holds a plain object reference, and its only uses are loads, stores and
+/// its marker, fill in 'info' and return true. 'hasLoads' is set if the root is loaded.
+bool getSimpleRoot(AllocaInst * root, SimpleRoot & info, bool & hasLoads) {
+  if (!root->getAllocatedType()->isPointerTy()) {
+    return false;
+  }
+
+  info.alloca = root;
+  info.marker = NULL;
+  info.cast = NULL;
+  hasLoads = false;
+  for (Value::use_iterator ui = root->use_begin(); ui != root->use_end(); ++ui) {
+    User * user = *ui;
+    if (isa<LoadInst>(user)) {
+      hasLoads = true;
+    } else if (StoreInst * si = dyn_cast<StoreInst>(user)) {
+      if (si->getOperand(0) == root) {
+        // The address of the root is stored somewhere.
+        return false;
+      }
+    } else if (isGCRootMarker(user)) {
+      info.marker = cast<IntrinsicInst>(user);
+    } else if (BitCastInst * bc = dyn_cast<BitCastInst>(user)) {
+      if (info.cast != NULL || !bc->hasOneUse() || !isGCRootMarker(*bc->use_begin())) {
+        return false;
+      }
+
+      info.cast = bc;
+      info.marker = cast<IntrinsicInst>(*bc->use_begin());
+    } else {
+      return false;
+    }
+  }
+
+  // Roots with metadata are aggregates, traced using a table of field offsets.
+  return info.marker != NULL && isa<ConstantPointerNull>(info.marker->getArgOperand(1));
+}
+
+/// True if 'inst' will be given a safe point by the code generator.
+bool isSafePoint(Instruction * inst) {
+  CallSite cs(inst);
+  return cs && !isa<DbgInfoIntrinsic>(inst) && !isGCRootMarker(inst);
+}
+
+/// Remove the marker of a root, so that it no longer appears in the stack map.
+void removeMarker(SimpleRoot & root) {
+  root.marker->eraseFromParent();
+  if (root.cast != NULL) {
+    root.cast->eraseFromParent();
+  }
+}
+
+}
+
+bool TartGCStrategy::optimizeRoots(Function & fn, ArrayRef<AllocaInst *> roots) {
+  // A root which is never loaded keeps an object alive on behalf of some other copy of
+  // the reference, so its liveness can't be determined from its own uses. Leave it alone.
+  SmallVector<SimpleRoot, 32> tracked;
+  DenseMap<const Value *, unsigned> rootIndex;
+  for (ArrayRef<AllocaInst *>::iterator it = roots.begin(); it != roots.end(); ++it) {
+    SimpleRoot info;
+    bool hasLoads;
+    if (!rootIndex.count(*it) && getSimpleRoot(*it, info, hasLoads) && hasLoads) {
+      rootIndex[*it] = tracked.size();
+      tracked.push_back(info);
+    }
+  }
+
+  unsigned count = tracked.size();
+  if (count == 0) {
+    return false;
+  }
+
+  // Find the loads and stores of the roots in each block.
+  DenseMap<const BasicBlock *, unsigned> blockIndex;
+  std::vector<BlockLiveness> blocks(fn.size());
+  unsigned bbIndex = 0;
+  for (Function::iterator bb = fn.begin(); bb != fn.end(); ++bb, ++bbIndex) {
+    blockIndex[bb] = bbIndex;
+    BlockLiveness & bl = blocks[bbIndex];
+    bl.use.resize(count);
+    bl.def.resize(count);
+    bl.liveIn.resize(count);
+    bl.liveOut.resize(count);
+    for (BasicBlock::iterator ii = bb->begin(); ii != bb->end(); ++ii) {
+      if (LoadInst * li = dyn_cast<LoadInst>(ii)) {
+        DenseMap<const Value *, unsigned>::const_iterator r = rootIndex.find(li->getOperand(0));
+        if (r != rootIndex.end() && !bl.def.test(r->second)) {
+          bl.use.set(r->second);
+        }
+      } else if (StoreInst * si = dyn_cast<StoreInst>(ii)) {
+        DenseMap<const Value *, unsigned>::const_iterator r = rootIndex.find(si->getOperand(1));
+        if (r != rootIndex.end()) {
+          bl.def.set(r->second);
+        }
+      }
+    }
+  }
+
+  // Solve for the roots live on entry to and exit from each block.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Function::iterator bb = fn.end(); bb != fn.begin();) {
+      --bb;
+      BlockLiveness & bl = blocks[blockIndex[bb]];
+      for (succ_iterator si = succ_begin(bb); si != succ_end(bb); ++si) {
+        bl.liveOut |= blocks[blockIndex[*si]].liveIn;
+      }
+
+      for (unsigned i = 0; i < count; ++i) {
+        bool live = bl.use.test(i) || (bl.liveOut.test(i) && !bl.def.test(i));
+        if (live && !bl.liveIn.test(i)) {
+          bl.liveIn.set(i);
+          changed = true;
+        }
+      }
+    }
+  }
+
+  // Walk backwards through each block, noting which roots are live after each safe
+  // point, and which roots are live when another root is stored.
+  BitVector liveAtSafePoint(count);
+  std::vector<BitVector> interferes(count, BitVector(count));
+  for (Function::iterator bb = fn.begin(); bb != fn.end(); ++bb) {
+    BitVector live = blocks[blockIndex[bb]].liveOut;
+    for (BasicBlock::iterator ii = bb->end(); ii != bb->begin();) {
+      --ii;
+      if (LoadInst * li = dyn_cast<LoadInst>(ii)) {
+        DenseMap<const Value *, unsigned>::const_iterator r = rootIndex.find(li->getOperand(0));
+        if (r != rootIndex.end()) {
+          live.set(r->second);
+        }
+      } else if (StoreInst * si = dyn_cast<StoreInst>(ii)) {
+        DenseMap<const Value *, unsigned>::const_iterator r = rootIndex.find(si->getOperand(1));
+        if (r != rootIndex.end()) {
+          unsigned def = r->second;
+          for (int i = live.find_first(); i >= 0; i = live.find_next(i)) {
+            if (unsigned(i) != def) {
+              interferes[def].set(i);
+              interferes[i].set(def);
+            }
+          }
+
+          live.reset(def);
+        }
+      } else if (isSafePoint(ii)) {
+        liveAtSafePoint |= live;
+      }
+    }
+  }
+
+  // A root which is never live across a safe point is never traced, so it can be kept
+  // in a register. The remaining roots share stack slots where their live ranges don't
+  // overlap, which makes the stack map smaller.
+  std::vector<AllocaInst *> promotable;
+  SmallVector<unsigned, 16> slots;
+  SmallVector<BitVector, 16> slotMembers;
+  for (unsigned i = 0; i < count; ++i) {
+    SimpleRoot & root = tracked[i];
+    if (!liveAtSafePoint.test(i)) {
+      removeMarker(root);
+      if (isAllocaPromotable(root.alloca)) {
+        promotable.push_back(root.alloca);
+      }
+
+      continue;
+    }
+
+    bool merged = false;
+    for (unsigned s = 0; s < slots.size(); ++s) {
+      AllocaInst * slot = tracked[slots[s]].alloca;
+      BitVector overlap = interferes[i];
+      overlap &= slotMembers[s];
+      if (slot->getAllocatedType() == root.alloca->getAllocatedType() && !overlap.any()) {
+        slotMembers[s].set(i);
+        removeMarker(root);
+        root.alloca->replaceAllUsesWith(slot);
+        root.alloca->eraseFromParent();
+        merged = true;
+        break;
+      }
+    }
+
+    if (!merged) {
+      slots.push_back(i);
+      slotMembers.push_back(BitVector(count));
+      slotMembers.back().set(i);
+    }
+  }
+
+  if (!promotable.empty()) {
+    DominatorTree domTree;
+    domTree.runOnFunction(fn);
+    PromoteMemToReg(promotable, domTree);
+  }
+
+  return true;
+}
+
+bool TartGCStrategy::insertSafepointPolls(Function & fn) {
+  // Find the sources of all loop back-edges.
+  SmallVector<std::pair<const BasicBlock *, const BasicBlock *>, 16> backEdges;
+  FindFunctionBackedges(fn, backEdges);
+  SmallPtrSet<BasicBlock *, 16> pollBlocks;
+  for (size_t i = 0; i < backEdges.size(); ++i) {
+    pollBlocks.insert(const_cast<BasicBlock *>(backEdges[i].first));
+  }
+
+  // A function which makes no calls and has no loops will return promptly, so only
+  // functions which make calls need a poll on entry.
+  bool hasCalls = false;
+  for (Function::iterator bb = fn.begin(), bbEnd = fn.end(); bb != bbEnd && !hasCalls; ++bb) {
+    for (BasicBlock::iterator ii = bb->begin(), iiEnd = bb->end(); ii != iiEnd; ++ii) {
+      CallSite cs(ii);
+      if (cs && !isa<IntrinsicInst>(ii)) {
+        hasCalls = true;
+        break;
+      }
+    }
+  }
+
+  if (pollBlocks.empty() && !hasCalls) {
+    return false;
+  }
+
+  Module * module = fn.getParent();
+  LLVMContext & context = module->getContext();
+  Constant * flag = module->getOrInsertGlobal("GC_safepointRequested",
+      Type::getInt32Ty(context));
+  Constant * pollFn = module->getOrInsertFunction("GC_safepoint",
+      Type::getVoidTy(context), NULL);
+
+  for (SmallPtrSet<BasicBlock *, 16>::iterator it = pollBlocks.begin();
+      it != pollBlocks.end(); ++it) {
+    insertFlaggedCall((*it)->getTerminator(), flag, pollFn, ArrayRef<Value *>(), "safepoint");
+  }
+
+  if (hasCalls) {
+    // Poll after the allocas and root initializers in the entry block.
+    BasicBlock::iterator ip = fn.getEntryBlock().begin();
+    while (!couldBecomeSafePoint(ip)) {
+      ++ip;
+    }
+    insertFlaggedCall(ip, flag, pollFn, ArrayRef<Value *>(), "safepoint");
+  }
+
+  return true;
+}
+
+bool TartGCStrategy::lowerWriteBarriers(Function & fn, ArrayRef<CallInst *> writes) {
+  Module * module = fn.getParent();
+  LLVMContext & context = module->getContext();
+  Type * bytePtrType = Type::getInt8PtrTy(context);
+  Constant * flag = module->getOrInsertGlobal("GC_markingActive", Type::getInt32Ty(context));
+  Constant * barrierFn = module->getOrInsertFunction("GC_writeBarrier",
+      Type::getVoidTy(context), bytePtrType, bytePtrType->getPointerTo(), NULL);
+  Constant * slotBarrierFn = module->getOrInsertFunction("GC_writeBarrierSlot",
+      Type::getVoidTy(context), bytePtrType->getPointerTo(), NULL);
+
+  for (ArrayRef<CallInst *>::iterator it = writes.begin(); it != writes.end(); ++it) {
+    // llvm.gcwrite(value, object, slot)
+    CallInst * ci = *it;
+    Value * value = ci->getArgOperand(0);
+    Value * object = ci->getArgOperand(1);
+    Value * slot = ci->getArgOperand(2);
+
+    // A null object means the compiler could not tell which object the slot belongs to,
+    // so the runtime decides whether to log the old value from the slot address alone.
+    if (isa<ConstantPointerNull>(object)) {
+      Value * args[] = { slot };
+      insertFlaggedCall(ci, flag, slotBarrierFn, args, "barrier");
+    } else {
+      Value * args[] = { object, slot };
+      insertFlaggedCall(ci, flag, barrierFn, args, "barrier");
+    }
+
+    new StoreInst(value, slot, ci);
+    insertCardMark(ci, slot);
+    ci->eraseFromParent();
+  }
+
+  return true;
+}
+
+void TartGCStrategy::insertCardMark(Instruction * inst, Value * slot) {
+  BasicBlock * bb = inst->getParent();
+  Function * fn = bb->getParent();
+  Module * module = fn->getParent();
+  LLVMContext & context = module->getContext();
+  Type * bytePtrType = Type::getInt8PtrTy(context);
+  TargetData targetData(module);
+  IntegerType * intPtrType = targetData.getIntPtrType(context);
+  Constant * tableVar = module->getOrInsertGlobal("GC_cardTableBiased", bytePtrType);
+  Constant * firstVar = module->getOrInsertGlobal("GC_cardHeapFirst", bytePtrType);
+  Constant * lastVar = module->getOrInsertGlobal("GC_cardHeapLast", bytePtrType);
+
+  BasicBlock * cont = bb->splitBasicBlock(inst, "card.cont");
+  BasicBlock * markBlock = BasicBlock::Create(context, "card.mark", fn, cont);
+
+  // Only slots within the collected heap have cards; stores into static data, or memory
+  // allocated outside the collector, are ignored.
+  TerminatorInst * br = bb->getTerminator();
+  Value * slotAddr = new BitCastInst(slot, bytePtrType, "card.slot", br);
+  Value * inHeap = BinaryOperator::CreateAnd(
+      new ICmpInst(br, ICmpInst::ICMP_UGE, slotAddr, new LoadInst(firstVar, "", br)),
+      new ICmpInst(br, ICmpInst::ICMP_ULT, slotAddr, new LoadInst(lastVar, "", br)),
+      "card.inheap", br);
+  BranchInst::Create(markBlock, cont, inHeap, br);
+  br->eraseFromParent();
+
+  // table[slot >> TART_CARD_SHIFT] = 1
+  Value * index = BinaryOperator::CreateLShr(
+      new PtrToIntInst(slotAddr, intPtrType, "", markBlock),
+      ConstantInt::get(intPtrType, TART_CARD_SHIFT), "card.index", markBlock);
+  Value * card = GetElementPtrInst::Create(
+      new LoadInst(tableVar, "card.table", markBlock), index, "card.addr", markBlock);
+  new StoreInst(ConstantInt::get(Type::getInt8Ty(context), 1), card, markBlock);
+  BranchInst::Create(cont, markBlock);
+}
+
+void TartGCStrategy::insertFlaggedCall(Instruction * inst, Constant * flag, Constant * callee,
+    ArrayRef<Value *> args, StringRef prefix) {
+  BasicBlock * bb = inst->getParent();
+  Function * fn = bb->getParent();
+  LLVMContext & context = fn->getContext();
+  BasicBlock * cont = bb->splitBasicBlock(inst, prefix + ".cont");
+  BasicBlock * callBlock = BasicBlock::Create(context, prefix + ".call", fn, cont);
+  CallInst::Create(callee, args, "", callBlock);
+  BranchInst::Create(cont, callBlock);
+
+  // Replace the unconditional branch left by splitBasicBlock with a test of the flag.
+  TerminatorInst * br = bb->getTerminator();
+  LoadInst * flagValue = new LoadInst(flag, prefix + ".flag", true, br);
+  Value * isSet = new ICmpInst(br, ICmpInst::ICMP_NE, flagValue,
+      ConstantInt::get(Type::getInt32Ty(context), 0), prefix + ".set");
+  BranchInst::Create(callBlock, cont, isSet, br);
+  br->eraseFromParent();
+}
+
 // CouldBecomeSafePoint - Predicate to conservatively determine whether the
 // instruction could introduce a safe point.
 bool TartGCStrategy::couldBecomeSafePoint(Instruction * inst) {
@@ -156,7 +555,8 @@ void TartGCPrinter::beginAssembly(AsmPrinter &AP) {
 
 void TartGCPrinter::finishAssembly(AsmPrinter &AP) {
   unsigned nextLabel = 1;
-  SafePointList safePoints;
+  unsigned nextFunctionLabel = 1;
+  FunctionSafePointList functions;
 
   // Set up for emitting addresses.
   int pointerSize = AP.TM.getTargetData()->getPointerSize();
@@ -175,6 +575,7 @@ void TartGCPrinter::finishAssembly(AsmPrinter &AP) {
   // For each function...
   for (iterator FI = begin(), FE = end(); FI != FE; ++FI) {
     GCFunctionInfo & gcFn = **FI;
+    SafePointList safePoints;
 
 //    if (optShowGC) {
 //      errs() << "GCStrategy: Function: " << gcFn.getFunction().getName() << "\n";
@@ -319,17 +720,42 @@ void TartGCPrinter::finishAssembly(AsmPrinter &AP) {
 //        }
 //      }
     }
+
+    // Emit the function's safe points. Block placement runs after the safe points are
+    // collected, so they aren't necessarily in order of address; the runtime sorts them
+    // and recomputes the end of the range when the module is registered.
+    if (!safePoints.empty()) {
+      FunctionSafePoints fsp;
+      fsp.startLabel = AP.Mang->getSymbol(&gcFn.getFunction());
+      fsp.endLabel = safePoints.back().first;
+      fsp.count = safePoints.size();
+      fsp.tableLabel = AP.GetTempSymbol("gc_safepoints", nextFunctionLabel++);
+      functions.push_back(fsp);
+
+      outStream.AddBlankLine();
+      AP.EmitAlignment(addressAlignLog);
+      outStream.EmitLabel(fsp.tableLabel);
+      for (SafePointList::const_iterator it = safePoints.begin(); it != safePoints.end(); ++it) {
+        outStream.EmitSymbolValue(it->first, pointerSize, 0);
+        outStream.EmitSymbolValue(it->second, pointerSize, 0);
+      }
+    }
   }
 
-  // Finally, generate the safe point map.
+  // Finally, generate the safe point map: a list of function address ranges, which the
+  // runtime sorts when the module is registered, and searches with a binary search.
   outStream.AddBlankLine();
+  AP.EmitAlignment(addressAlignLog);
   MCSymbol * gcSafepointSymbol = AP.GetExternalSymbolSymbol("GC_safepoint_map");
   outStream.EmitSymbolAttribute(gcSafepointSymbol, MCSA_Global);
   outStream.EmitLabel(gcSafepointSymbol);
-  outStream.EmitIntValue(safePoints.size(), pointerSize, 0);
-  for (SafePointList::const_iterator it = safePoints.begin(); it != safePoints.end(); ++it) {
-    outStream.EmitSymbolValue(it->first, pointerSize, 0);
-    outStream.EmitSymbolValue(it->second, pointerSize, 0);
+  outStream.EmitIntValue(functions.size(), pointerSize, 0);
+  for (FunctionSafePointList::const_iterator it = functions.begin(); it != functions.end();
+      ++it) {
+    outStream.EmitSymbolValue(it->startLabel, pointerSize, 0);
+    outStream.EmitSymbolValue(it->endLabel, pointerSize, 0);
+    outStream.EmitIntValue(it->count, pointerSize, 0);
+    outStream.EmitSymbolValue(it->tableLabel, pointerSize, 0);
   }
 }
 
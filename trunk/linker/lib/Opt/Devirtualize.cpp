@@ -0,0 +1,332 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include "llvm/Module.h"
+#include "llvm/Function.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Metadata.h"
+#include "llvm/Operator.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "tart/Opt/Devirtualize.h"
+#include "tart/Gen/TypeInfoBlock.h"
+
+namespace tart {
+
+char Devirtualize::ID = 0;
+
+namespace {
+
+RegisterPass<Devirtualize> X(
+    "tart-devirtualize", "Replace virtual calls having a single target with direct calls",
+    false /* Only looks at CFG */,
+    false /* Analysis Pass */);
+
+cl::opt<bool> showDevirtualized("show-devirtualized",
+    cl::desc("Print the number of calls made direct by whole-program devirtualization"));
+
+/// Return the initializer of the global variable referred to by 'value', or NULL.
+const Constant * globalInit(const Value * value) {
+  if (const GlobalVariable * gv = dyn_cast<GlobalVariable>(value->stripPointerCasts())) {
+    if (gv->hasInitializer()) {
+      return gv->getInitializer();
+    }
+  }
+
+  return NULL;
+}
+
+}
+
+void Devirtualize::getAnalysisUsage(AnalysisUsage & AU) const {
+  AU.setPreservesCFG();
+}
+
+bool Devirtualize::runOnModule(Module & module) {
+  if (!findClasses(module)) {
+    return false;
+  }
+
+  unsigned vcallKind = module.getMDKindID("tart.vcall");
+  unsigned icallKind = module.getMDKindID("tart.icall");
+  unsigned guardKind = module.getMDKindID("tart.icall.guard");
+
+  SmallVector<Instruction *, 64> vcalls;
+  SmallVector<Instruction *, 64> icalls;
+  for (Module::iterator fn = module.begin(); fn != module.end(); ++fn) {
+    for (Function::iterator bb = fn->begin(); bb != fn->end(); ++bb) {
+      for (BasicBlock::iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+        if (inst->getMetadata(vcallKind) != NULL) {
+          vcalls.push_back(inst);
+        } else if (inst->getMetadata(icallKind) != NULL && !hasProxies_) {
+          icalls.push_back(inst);
+        }
+      }
+    }
+  }
+
+  unsigned devirtualized = 0;
+  for (SmallVectorImpl<Instruction *>::iterator it = vcalls.begin(); it != vcalls.end(); ++it) {
+    Instruction * lookup = *it;
+    MDNode * info = lookup->getMetadata(vcallKind);
+    Constant * method = resolveExact(lookup, info);
+    if (method == NULL) {
+      method = resolveVirtual(info);
+    }
+
+    if (method != NULL) {
+      lookup->replaceAllUsesWith(ConstantExpr::getBitCast(method, lookup->getType()));
+      lookup->eraseFromParent();
+      ++devirtualized;
+    }
+  }
+
+  for (SmallVectorImpl<Instruction *>::iterator it = icalls.begin(); it != icalls.end(); ++it) {
+    Instruction * lookup = *it;
+    MDNode * info = lookup->getMetadata(icallKind);
+    if (Constant * method = resolveInterface(module, info)) {
+      // Make the fast paths of the lookup unconditional, so that the slow paths, which
+      // call out to the dispatcher, become unreachable.
+      Function * fn = lookup->getParent()->getParent();
+      SmallVector<Instruction *, 4> guards;
+      for (Function::iterator bb = fn->begin(); bb != fn->end(); ++bb) {
+        for (BasicBlock::iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+          if (inst->getMetadata(guardKind) == info) {
+            guards.push_back(inst);
+          }
+        }
+      }
+
+      for (SmallVectorImpl<Instruction *>::iterator g = guards.begin(); g != guards.end(); ++g) {
+        (*g)->replaceAllUsesWith(ConstantInt::getTrue(module.getContext()));
+        (*g)->eraseFromParent();
+      }
+
+      lookup->replaceAllUsesWith(ConstantExpr::getBitCast(method, lookup->getType()));
+      lookup->eraseFromParent();
+      ++devirtualized;
+    }
+  }
+
+  if (showDevirtualized) {
+    errs() << "Devirtualized " << devirtualized << " of " << (vcalls.size() + icalls.size()) <<
+        " method lookups\n";
+  }
+
+  return devirtualized != 0;
+}
+
+bool Devirtualize::findClasses(Module & module) {
+  classes_.clear();
+  classMap_.clear();
+  hasProxies_ = false;
+
+  for (Module::global_iterator it = module.global_begin(); it != module.global_end(); ++it) {
+    GlobalVariable * gv = it;
+    StringRef name = gv->getName();
+    if (name.endswith(".type.proxy.tib")) {
+      // A proxy can implement any interface, so interface calls can't be resolved.
+      hasProxies_ = true;
+    } else if (name.endswith(".TIB")) {
+      if (!gv->hasInitializer()) {
+        // The type is defined outside of the program, so the hierarchy is open.
+        return false;
+      }
+
+      const ConstantStruct * tib = dyn_cast<ConstantStruct>(gv->getInitializer());
+      if (tib == NULL || tib->getNumOperands() < TIB_FIELD_COUNT) {
+        continue;
+      }
+
+      const ConstantInt * depth = dyn_cast<ConstantInt>(tib->getOperand(TIB_DEPTH));
+      if (depth == NULL || depth->getSExtValue() < 0) {
+        continue;
+      }
+
+      ClassInfo info;
+      info.tib = gv;
+      info.depth = int(depth->getSExtValue());
+      info.display = globalInit(tib->getOperand(TIB_DISPLAY));
+      info.bases = globalInit(tib->getOperand(TIB_BASES));
+      info.itable = globalInit(tib->getOperand(TIB_ITABLE));
+      info.methods = tib->getOperand(TIB_METHOD_TABLE);
+      classes_.push_back(info);
+    }
+  }
+
+  for (ClassList::iterator it = classes_.begin(); it != classes_.end(); ++it) {
+    classMap_[it->tib->getName()] = &*it;
+  }
+
+  return true;
+}
+
+Constant * Devirtualize::resolveExact(Instruction * lookup, const MDNode * info) {
+  // The lookup is a cast of a load from the method table of the receiver's TIB. If the
+  // TIB is a constant, the receiver's exact class is known, whatever its subclasses do.
+  LoadInst * load = dyn_cast<LoadInst>(lookup->getOperand(0));
+  const ConstantInt * index = dyn_cast<ConstantInt>(info->getOperand(1));
+  if (load == NULL || index == NULL) {
+    return NULL;
+  }
+
+  GEPOperator * gep = dyn_cast<GEPOperator>(load->getPointerOperand());
+  if (gep == NULL || gep->getNumIndices() != 3) {
+    return NULL;
+  }
+
+  const ConstantInt * field = dyn_cast<ConstantInt>(gep->getOperand(2));
+  if (field == NULL || field->getZExtValue() != TIB_METHOD_TABLE) {
+    return NULL;
+  }
+
+  // The TIB pointer is either a constant already, or is read from a constant object.
+  Value * tibValue = gep->getPointerOperand();
+  if (LoadInst * tibLoad = dyn_cast<LoadInst>(tibValue)) {
+    if (Constant * objectPtr = dyn_cast<Constant>(tibLoad->getPointerOperand())) {
+      if (Constant * folded = ConstantFoldLoadFromConstPtr(objectPtr)) {
+        tibValue = folded;
+      }
+    }
+  }
+
+  const GlobalVariable * tib = dyn_cast<GlobalVariable>(tibValue->stripPointerCasts());
+  if (tib == NULL) {
+    return NULL;
+  }
+
+  StringMap<ClassInfo *>::const_iterator cls = classMap_.find(tib->getName());
+  if (cls == classMap_.end()) {
+    return NULL;
+  }
+
+  return methodAt(cls->second->methods, unsigned(index->getZExtValue()));
+}
+
+Constant * Devirtualize::resolveVirtual(const MDNode * info) {
+  const MDString * tibName = dyn_cast<MDString>(info->getOperand(0));
+  const ConstantInt * index = dyn_cast<ConstantInt>(info->getOperand(1));
+  if (tibName == NULL || index == NULL) {
+    return NULL;
+  }
+
+  StringMap<ClassInfo *>::const_iterator cls = classMap_.find(tibName->getString());
+  if (cls == classMap_.end()) {
+    return NULL;
+  }
+
+  // Every subclass has the class at the same position in its display.
+  const GlobalVariable * baseTib = cls->second->tib;
+  unsigned depth = unsigned(cls->second->depth);
+  Constant * result = NULL;
+  for (ClassList::iterator it = classes_.begin(); it != classes_.end(); ++it) {
+    const ConstantArray * display = dyn_cast_or_null<ConstantArray>(it->display);
+    if (display == NULL || unsigned(it->depth) < depth ||
+        display->getOperand(depth)->stripPointerCasts() != baseTib) {
+      continue;
+    }
+
+    Constant * method = methodAt(it->methods, unsigned(index->getZExtValue()));
+    if (method == NULL) {
+      // An abstract method, which can't be called on this class.
+      continue;
+    }
+
+    if (result != NULL && result != method) {
+      return NULL;
+    }
+
+    result = method;
+  }
+
+  return result;
+}
+
+Constant * Devirtualize::resolveInterface(Module & module, const MDNode * info) {
+  const MDString * tibName = dyn_cast<MDString>(info->getOperand(0));
+  const Value * iname = info->getOperand(1);
+  const ConstantInt * index = dyn_cast<ConstantInt>(info->getOperand(2));
+  if (tibName == NULL || iname == NULL || index == NULL) {
+    return NULL;
+  }
+
+  const GlobalVariable * ifaceTib = module.getGlobalVariable(tibName->getString(), true);
+  if (ifaceTib == NULL) {
+    return NULL;
+  }
+
+  Constant * result = NULL;
+  for (ClassList::iterator it = classes_.begin(); it != classes_.end(); ++it) {
+    const ConstantArray * bases = dyn_cast_or_null<ConstantArray>(it->bases);
+    if (bases == NULL) {
+      continue;
+    }
+
+    bool implements = false;
+    for (unsigned i = 0; i < bases->getNumOperands(); ++i) {
+      if (bases->getOperand(i)->stripPointerCasts() == ifaceTib) {
+        implements = true;
+        break;
+      }
+    }
+
+    if (!implements) {
+      continue;
+    }
+
+    // If the interface collided with another in this class's itable, give up, since the
+    // method table can only be found through the dispatcher.
+    const Constant * methods = findInterface(it->itable, iname);
+    if (methods == NULL) {
+      return NULL;
+    }
+
+    Constant * method = methodAt(methods, unsigned(index->getZExtValue()));
+    if (method == NULL) {
+      continue;
+    }
+
+    if (result != NULL && result != method) {
+      return NULL;
+    }
+
+    result = method;
+  }
+
+  return result;
+}
+
+Constant * Devirtualize::methodAt(const Constant * methods, unsigned index) {
+  const ConstantArray * methodArray = dyn_cast_or_null<ConstantArray>(methods);
+  if (methodArray == NULL || index >= methodArray->getNumOperands()) {
+    return NULL;
+  }
+
+  Constant * method = cast<Constant>(methodArray->getOperand(index)->stripPointerCasts());
+  if (!isa<Function>(method)) {
+    return NULL;
+  }
+
+  return method;
+}
+
+const Constant * Devirtualize::findInterface(const Constant * itable, const Value * iname) {
+  const ConstantArray * slots = dyn_cast_or_null<ConstantArray>(itable);
+  if (slots == NULL) {
+    return NULL;
+  }
+
+  const Value * iid = iname->stripPointerCasts();
+  for (unsigned i = 0; i + 1 < slots->getNumOperands(); i += 2) {
+    if (slots->getOperand(i)->stripPointerCasts() == iid) {
+      return globalInit(slots->getOperand(i + 1));
+    }
+  }
+
+  return NULL;
+}
+
+} // namespace tart
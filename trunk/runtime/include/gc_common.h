@@ -45,6 +45,20 @@ struct StackFrameDescMapEntry {
   TraceDescriptor * traceTable;
 };
 
+struct StackFrameRange {
+  // The entry point of the function.
+  void * startAddr;
+
+  // The address of the highest safe point in the function. Set when the range is
+  // registered.
+  void * endAddr;
+
+  // The safe points of the function. Sorted by increasing address when the range is
+  // registered.
+  size_t safePointCount;
+  StackFrameDescMapEntry * safePoints;
+};
+
 struct StaticRootsTableEntry {
   // The address of the static root
   void * rootAddr;
@@ -58,6 +72,32 @@ struct CallFrame {
   void * returnAddr;
 };
 
+/** Read the frame pointer register of the calling function into 'framePtr'. */
+#if _MSC_VER
+  #if SIZEOF_VOID_PTR == 4
+    #define GC_READ_FRAME_POINTER(framePtr) __asm { mov framePtr, ebp }
+  #else
+    #define GC_READ_FRAME_POINTER(framePtr) __asm { mov framePtr, rbp }
+  #endif
+#else
+  #if SIZEOF_VOID_PTR == 4
+    #define GC_READ_FRAME_POINTER(framePtr) __asm__("movl %%ebp, %0" :"=r"(framePtr))
+  #else
+    #define GC_READ_FRAME_POINTER(framePtr) __asm__("movq %%rbp, %0" :"=r"(framePtr))
+  #endif
+#endif
+
+/** Trace all of the stack frames in the chain starting at 'framePtr'. */
+void GC_traceFrames(CallFrame * framePtr, tart_object * traceAction);
+
+/** Mark the calling thread as being in a blocking operation, so that collections can
+    proceed without waiting for it. The stack is traced from 'framePtr', which must be
+    the frame of a function that stays on the stack until GC_endBlocking is called. */
+void GC_beginBlocking(CallFrame * framePtr);
+
+/** End a blocking operation, waiting for any collection in progress to finish. */
+void GC_endBlocking();
+
 #if 0
 struct Segment {
   Segment * next;
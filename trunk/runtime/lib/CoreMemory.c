@@ -6,6 +6,23 @@
 #include <stdlib.h>
 #endif
 
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#if HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#if HAVE_SYS_MMAN_H && HAVE_MMAP
+  #define USE_MMAP 1
+  #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+#else
+  #define USE_MMAP 0
+#endif
+
 void * PageAllocator_allocImpl(int pageSize, int numPages) {
 #ifdef HAVE_POSIX_MEMALIGN
   void * memptr;
@@ -37,3 +54,44 @@ void PageAllocator_freeImpl(void * mem, int size) {
   (void)size;
 #endif
 }
+
+/** Map a page-aligned region of 'size' bytes directly from the operating system. 'size'
+    must be a multiple of the page size. The memory is zero-filled. */
+void * PageAllocator_mapImpl(size_t size) {
+#if USE_MMAP
+  void * mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    fprintf(stderr, "Unable to map %lu bytes of memory\n", (unsigned long) size);
+    abort();
+  }
+  return mem;
+#else
+  void * mem = PageAllocator_allocImpl(4096, (size + 4095) / 4096);
+  if (mem == NULL) {
+    fprintf(stderr, "Unable to allocate %lu bytes of memory\n", (unsigned long) size);
+    abort();
+  }
+  return mem;
+#endif
+}
+
+/** Return a region previously obtained from PageAllocator_mapImpl to the operating system. */
+void PageAllocator_unmapImpl(void * mem, size_t size) {
+#if USE_MMAP
+  munmap(mem, size);
+#else
+  PageAllocator_freeImpl(mem, size);
+#endif
+}
+
+/** Tell the operating system that the physical pages backing a region are no longer
+    needed. The address range remains valid, but its contents are undefined until it is
+    written again. 'mem' and 'size' must be page-aligned. */
+void PageAllocator_releaseImpl(void * mem, size_t size) {
+#if USE_MMAP && HAVE_MADVISE
+  madvise(mem, size, MADV_DONTNEED);
+#else
+  (void)mem;
+  (void)size;
+#endif
+}
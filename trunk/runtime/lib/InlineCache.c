@@ -0,0 +1,35 @@
+/** Inline caches for interface method calls. */
+
+#include "config.h"
+
+#include <stddef.h>
+
+// Number of entries in each call site's cache. Must match the compiler.
+#define INLINE_CACHE_ENTRIES 2
+
+// One entry of an inline cache: a receiver TIB, and the method that the call site
+// resolved to for receivers of that type.
+//
+// Entries are filled at most once, and never change afterwards. A filler first claims
+// the entry by setting the method, and only then publishes the TIB, so a call site which
+// reads a matching TIB (with acquire ordering) is guaranteed to see the right method.
+struct InlineCacheEntry {
+  const void * volatile tib;
+  void * volatile method;
+};
+
+// Called on a cache miss, after the method has been looked up the slow way. Call sites
+// check inline that the last entry is still empty first, so once the cache is full they
+// stop calling this. If another thread fills the cache in the meantime it is left alone.
+void InlineCache_fill(struct InlineCacheEntry * cache, const void * tib, void * method) {
+#if HAVE_GCC_ATOMICS
+  int i;
+  for (i = 0; i < INLINE_CACHE_ENTRIES; ++i) {
+    if (__sync_bool_compare_and_swap(&cache[i].method, NULL, method)) {
+      __sync_synchronize();
+      cache[i].tib = tib;
+      return;
+    }
+  }
+#endif
+}
@@ -0,0 +1,196 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+/* Support for the write barriers emitted by the compiler.
+
+   While marking is active, compiled code calls GC_writeBarrier before every store of a
+   reference into a heap object. The barrier records the value that is about to be
+   overwritten, so that every object which was reachable when marking started will be
+   marked, even if the mutator removes the last reference to it. Stores through a pointer
+   whose containing object is unknown call GC_writeBarrierSlot instead, which filters on
+   the address of the slot rather than on the object.
+
+   The logged values are pushed onto the same stack that the collector uses for objects
+   it has yet to mark, so both are drained by the same loop.
+
+   Every store of a reference into the heap also marks the card containing the updated
+   slot as dirty, so that a nursery collection need only scan the dirty parts of the older
+   spaces. Compiled code does this inline, using the variables set by GC_setCardTable. */
+
+#include "gc_common.h"
+#include "tart_object.h"
+#include "tart/GC/CardTable.h"
+
+#if HAVE_STRING_H
+  #include <string.h>
+#endif
+
+#if HAVE_STDIO_H
+  #include <stdio.h>
+#endif
+
+#if HAVE_PTHREADS
+  #include <pthread.h>
+#endif
+
+extern "C" {
+  extern volatile int32_t GC_markingActive;
+  void GC_setMarkingActive(bool active);
+  void GC_setBarrierFilter(void * first, void * last);
+  void GC_writeBarrier(void * object, void ** slot);
+  void GC_writeBarrierSlot(void ** slot);
+  void GC_markStackPush(void * obj);
+  void * GC_markStackPop();
+  void GC_markStackClear();
+  void GC_setCardTable(char * table, void * first, void * last, int32_t cardShift);
+  void GC_writeBarrierRange(void * first, size_t count, size_t elementSize,
+      const intptr_t * offsets, size_t offsetCount);
+  extern char * GC_cardTableBiased;
+  extern char * GC_cardHeapFirst;
+  extern char * GC_cardHeapLast;
+}
+
+/** Non-zero while incremental marking is in progress. Tested by compiled code before
+    calling GC_writeBarrier. */
+volatile int32_t GC_markingActive = 0;
+
+/** The card table, offset so that it can be indexed directly by (address >> TART_CARD_SHIFT).
+    Only addresses between GC_cardHeapFirst and GC_cardHeapLast have cards. */
+char * GC_cardTableBiased = NULL;
+char * GC_cardHeapFirst = NULL;
+char * GC_cardHeapLast = NULL;
+
+namespace {
+  static const size_t INITIAL_STACK_SIZE = 1024;
+
+  // Objects in this range are newer than the marking snapshot, so stores into them need
+  // not be logged. Their old field values may not even be valid pointers.
+  char * filterFirst;
+  char * filterLast;
+
+  // Overwritten values, and objects found by the collector, which are waiting to be marked.
+  void ** markStack;
+  size_t markStackSize;
+  size_t markStackCapacity;
+
+  #if HAVE_PTHREADS
+    pthread_mutex_t markStackLock = PTHREAD_MUTEX_INITIALIZER;
+  #endif
+}
+
+void GC_setMarkingActive(bool active) {
+  GC_markingActive = active ? 1 : 0;
+}
+
+void GC_setBarrierFilter(void * first, void * last) {
+  filterFirst = (char *)first;
+  filterLast = (char *)last;
+}
+
+void GC_writeBarrier(void * object, void ** slot) {
+  if ((char *)object >= filterFirst && (char *)object < filterLast) {
+    return;
+  }
+
+  void * oldValue = *slot;
+  if (oldValue != NULL) {
+    GC_markStackPush(oldValue);
+  }
+}
+
+void GC_writeBarrierSlot(void ** slot) {
+  // The slot may be on the stack, in static data or in any part of the heap. A slot
+  // inside an object newer than the snapshot is skipped for the same reason as above;
+  // logging the old value of any other reference slot is always safe.
+  if ((char *)slot >= filterFirst && (char *)slot < filterLast) {
+    return;
+  }
+
+  void * oldValue = *slot;
+  if (oldValue != NULL) {
+    GC_markStackPush(oldValue);
+  }
+}
+
+void GC_setCardTable(char * table, void * first, void * last, int32_t cardShift) {
+  if (cardShift != TART_CARD_SHIFT) {
+    fprintf(stderr, "Card size mismatch: collector uses 2^%d bytes, write barrier uses 2^%d\n",
+        (int)cardShift, TART_CARD_SHIFT);
+    abort();
+  }
+
+  GC_cardTableBiased = table - ((uintptr_t)first >> TART_CARD_SHIFT);
+  GC_cardHeapFirst = (char *)first;
+  GC_cardHeapLast = (char *)last;
+}
+
+/** Apply the write barrier to an array of 'count' elements of 'elementSize' bytes at
+    'first', which are about to be overwritten by a bulk copy. 'offsets' lists the byte
+    offsets of the reference fields within each element, taken from the element type's
+    trace table, so that non-reference fields are never mistaken for pointers. */
+void GC_writeBarrierRange(void * first, size_t count, size_t elementSize,
+    const intptr_t * offsets, size_t offsetCount) {
+  char * begin = (char *)first;
+  char * end = begin + count * elementSize;
+  if (GC_markingActive && (begin < filterFirst || begin >= filterLast)) {
+    for (char * elem = begin; elem < end; elem += elementSize) {
+      for (size_t i = 0; i < offsetCount; ++i) {
+        void * oldValue = *(void **)(elem + offsets[i]);
+        if (oldValue != NULL) {
+          GC_markStackPush(oldValue);
+        }
+      }
+    }
+  }
+
+  if (end > begin && begin >= GC_cardHeapFirst && begin < GC_cardHeapLast) {
+    uintptr_t firstCard = (uintptr_t)begin >> TART_CARD_SHIFT;
+    uintptr_t lastCard = ((uintptr_t)end - 1) >> TART_CARD_SHIFT;
+    memset(GC_cardTableBiased + firstCard, 1, lastCard - firstCard + 1);
+  }
+}
+
+void GC_markStackPush(void * obj) {
+  #if HAVE_PTHREADS
+    pthread_mutex_lock(&markStackLock);
+  #endif
+  if (markStackSize == markStackCapacity) {
+    size_t newCapacity = markStackCapacity == 0 ? INITIAL_STACK_SIZE : markStackCapacity * 2;
+    void ** newStack = (void **)realloc(markStack, newCapacity * sizeof(void *));
+    if (newStack == NULL) {
+      fprintf(stderr, "Unable to allocate collector mark stack\n");
+      abort();
+    }
+    markStack = newStack;
+    markStackCapacity = newCapacity;
+  }
+  markStack[markStackSize++] = obj;
+  #if HAVE_PTHREADS
+    pthread_mutex_unlock(&markStackLock);
+  #endif
+}
+
+void * GC_markStackPop() {
+  void * result = NULL;
+  #if HAVE_PTHREADS
+    pthread_mutex_lock(&markStackLock);
+  #endif
+  if (markStackSize > 0) {
+    result = markStack[--markStackSize];
+  }
+  #if HAVE_PTHREADS
+    pthread_mutex_unlock(&markStackLock);
+  #endif
+  return result;
+}
+
+void GC_markStackClear() {
+  #if HAVE_PTHREADS
+    pthread_mutex_lock(&markStackLock);
+  #endif
+  markStackSize = 0;
+  #if HAVE_PTHREADS
+    pthread_mutex_unlock(&markStackLock);
+  #endif
+}
@@ -6,6 +6,7 @@
 
 #include "gc_common.h"
 #include "tart_object.h"
+#include "tart_string.h"
 
 #if HAVE_UNISTD_H
   #include <unistd.h>
@@ -23,6 +24,10 @@
   #include <assert.h>
 #endif
 
+#if HAVE_SYS_TIME_H
+  #include <sys/time.h>
+#endif
+
 #define USE_PTHREAD_THREAD_LOCAL 0
 #if !HAVE_GCC_THREAD_LOCAL && HAVE_PTHREADS
   #include <pthread.h>
@@ -36,19 +41,23 @@
 
 extern "C" {
   void GC_initStackFrameDescMap(size_t * initData);
-  void GC_traceStack(tart_object * action);
+  int32_t GC_checkStackFrameDescMap();
   extern void TraceAction_traceDescriptors(tart_object * action,
       void * baseAddr, TraceDescriptor * traceTable);
   void GC_initThreadLocalData();
   tart_object * GC_getThreadLocalData();
   void GC_setThreadLocalData(tart_object * obj);
+  size_t GC_getPageSize();
   void * GC_allocAligned(size_t size);
+  void GC_freeAligned(void * mem);
+  uint32_t GC_getEnvSize(const String * name, uint32_t defaultValue);
+  int64_t GC_getMicroseconds();
+  void GC_zeroMemory(void * mem, size_t size);
 }
 
 namespace {
-  size_t stackFrameDescMapSize;
-  size_t stackFrameDescMapMask;
-  StackFrameDescMapEntry * stackFrameDescMap;
+  size_t stackFrameRangeCount;
+  StackFrameRange * stackFrameRanges;
   StaticRootsTableEntry * staticRootsTable;
 
   #if HAVE_GCC_THREAD_LOCAL
@@ -64,9 +73,18 @@ namespace {
   #endif
 }
 
-  /** Given an address, compute a hash of that address. */
-static size_t GC_hashAddress(void * addr) {
-  return (uintptr_t(addr) ^ (uintptr_t(addr) << 7)) * 2654435769u;
+/** Order function ranges by their start address. */
+static int GC_compareStackFrameRanges(const void * a, const void * b) {
+  uintptr_t aStart = uintptr_t(((const StackFrameRange *)a)->startAddr);
+  uintptr_t bStart = uintptr_t(((const StackFrameRange *)b)->startAddr);
+  return aStart < bStart ? -1 : (aStart > bStart ? 1 : 0);
+}
+
+/** Order safe points by their instruction address. */
+static int GC_compareSafePoints(const void * a, const void * b) {
+  uintptr_t aAddr = uintptr_t(((const StackFrameDescMapEntry *)a)->instructionAddr);
+  uintptr_t bAddr = uintptr_t(((const StackFrameDescMapEntry *)b)->instructionAddr);
+  return aAddr < bAddr ? -1 : (aAddr > bAddr ? 1 : 0);
 }
 
 size_t GC_getPageSize() {
@@ -102,76 +120,160 @@ void * GC_allocAligned(size_t size) {
   #endif
 }
 
+void GC_freeAligned(void * mem) {
+  #ifdef HAVE_POSIX_MEMALIGN
+    free(mem);
+  #elif HAVE_VALLOC
+    free(mem);
+  #elif HAVE_ALIGNED_MALLOC
+    _aligned_free(mem);
+  #endif
+}
+
+uint32_t GC_getEnvSize(const String * name, uint32_t defaultValue) {
+  char varName[128];
+  if (name->length <= 0 || name->length >= intptr_t(sizeof(varName))) {
+    return defaultValue;
+  }
+
+  memcpy(varName, name->start, name->length);
+  varName[name->length] = '\0';
+  const char * value = getenv(varName);
+  if (value == NULL || *value == '\0') {
+    return defaultValue;
+  }
+
+  // Accept an optional 'k', 'm' or 'g' suffix, so that sizes can be written as "512k" or "64m".
+  char * end;
+  uint64_t result = strtoull(value, &end, 0);
+  switch (*end) {
+    case 'k': case 'K': result <<= 10; break;
+    case 'm': case 'M': result <<= 20; break;
+    case 'g': case 'G': result <<= 30; break;
+    case '\0': break;
+    default:
+      fprintf(stderr, "Invalid value for environment variable %s: '%s'\n", varName, value);
+      return defaultValue;
+  }
+
+  // The collector's tuning parameters are 32-bit.
+  if (result > 0xffffffffu) {
+    fprintf(stderr, "Value of environment variable %s is too large: '%s'\n", varName, value);
+    return defaultValue;
+  }
+
+  return uint32_t(result);
+}
+
+void GC_zeroMemory(void * mem, size_t size) {
+  memset(mem, 0, size);
+}
+
+int64_t GC_getMicroseconds() {
+  #if HAVE_SYS_TIME_H
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return int64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
+  #else
+    return 0;
+  #endif
+}
+
 void GC_initStackFrameDescMap(size_t * initData) {
-  // get list of stack frame descriptors
-  size_t numEntries = *initData;
-  StackFrameDescMapEntry * entries = (StackFrameDescMapEntry *)(initData + 1);
-
-  // Find the nearest power of two larger than numEntries.
-  size_t tableSize = 64;
-  while (tableSize < numEntries) {
-    tableSize <<= 1;
+  // The map of each module is a list of function ranges, each with its own list of safe
+  // points. Every loaded module registers its map, so merge the new ranges into the
+  // table and sort it by address. This must not be called while a collection is running.
+  size_t numRanges = *initData;
+  StackFrameRange * ranges = (StackFrameRange *)(initData + 1);
+  if (numRanges == 0) {
+    return;
   }
 
-  // Multiply by two to give room for collisions.
-  stackFrameDescMapSize = tableSize * 2;
-  stackFrameDescMapMask = stackFrameDescMapSize - 1;
-  stackFrameDescMap = new StackFrameDescMapEntry[stackFrameDescMapSize];
-  memset(stackFrameDescMap, 0, sizeof(StackFrameDescMapEntry) * stackFrameDescMapSize);
-
-  for (size_t i = 0; i < numEntries; ++i, ++entries) {
-    size_t index = GC_hashAddress(entries->instructionAddr) & stackFrameDescMapMask;
-    size_t probeCount = 0;
-    while (stackFrameDescMap[index].instructionAddr != NULL) {
-      index = (index + 1) & stackFrameDescMapMask;
-      #if HAVE_ASSERT_H
-        if (probeCount >= 10) {
-          fprintf(stderr, "Collision for table size %lu, index %lu, entry %lu\n",
-              stackFrameDescMapSize, index, i);
-          abort();
-        }
-        assert(probeCount < 5);
-      #endif
-    }
-    #if HAVE_ASSERT_H
-      assert(index < stackFrameDescMapSize);
-    #endif
-    stackFrameDescMap[index].instructionAddr = entries->instructionAddr;
-    stackFrameDescMap[index].traceTable = entries->traceTable;
+  size_t tableSize = stackFrameRangeCount + numRanges;
+  StackFrameRange * table = new StackFrameRange[tableSize];
+  if (stackFrameRanges != NULL) {
+    memcpy(table, stackFrameRanges, sizeof(StackFrameRange) * stackFrameRangeCount);
+  }
+
+  memcpy(table + stackFrameRangeCount, ranges, sizeof(StackFrameRange) * numRanges);
+
+  // The safe points of a function are emitted in the order the collector strategy saw
+  // them, which is before block placement, so they may not be in order of address.
+  // Sort them (the tables are in the module's data section), and end each range at its
+  // highest safe point rather than the last one emitted.
+  for (StackFrameRange * range = table + stackFrameRangeCount; range < table + tableSize;
+      ++range) {
+    qsort(range->safePoints, range->safePointCount, sizeof(StackFrameDescMapEntry),
+        GC_compareSafePoints);
+    range->endAddr = range->safePoints[range->safePointCount - 1].instructionAddr;
   }
+
+  qsort(table, tableSize, sizeof(StackFrameRange), GC_compareStackFrameRanges);
+
+  delete[] stackFrameRanges;
+  stackFrameRanges = table;
+  stackFrameRangeCount = tableSize;
 }
 
 static TraceDescriptor * GC_lookupStackFrameDesc(void * addr) {
-  size_t index = GC_hashAddress(addr) & stackFrameDescMapMask;
-  while (stackFrameDescMap[index].instructionAddr != NULL) {
-    if (stackFrameDescMap[index].instructionAddr == addr) {
-      return stackFrameDescMap[index].traceTable;
+  // Find the last function which starts at or before the address.
+  uintptr_t key = uintptr_t(addr);
+  size_t lo = 0;
+  size_t hi = stackFrameRangeCount;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (uintptr_t(stackFrameRanges[mid].startAddr) <= key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  // Addresses past the last safe point belong to code which has no stack map.
+  if (lo == 0 || key > uintptr_t(stackFrameRanges[lo - 1].endAddr)) {
+    return NULL;
+  }
+
+  // The return address of a call from compiled code is always one of its safe points.
+  const StackFrameRange & range = stackFrameRanges[lo - 1];
+  lo = 0;
+  hi = range.safePointCount;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    uintptr_t spAddr = uintptr_t(range.safePoints[mid].instructionAddr);
+    if (spAddr == key) {
+      return range.safePoints[mid].traceTable;
+    } else if (spAddr < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
-    index = (index + 1) & stackFrameDescMapMask;
   }
+
   return NULL;
 }
 
-void GC_traceStack(tart_object * traceAction) {
-  CallFrame * framePtr;
-  #if _MSC_VER
-    #if SIZEOF_VOID_PTR == 4
-      __asm {
-        mov framePtr, ebp
-      }
-    #else
-      __asm {
-        mov framePtr, rbp
+int32_t GC_checkStackFrameDescMap() {
+  if (stackFrameRangeCount == 0) {
+    return -1;
+  }
+
+  int32_t missing = 0;
+  for (size_t i = 0; i < stackFrameRangeCount; ++i) {
+    const StackFrameRange & range = stackFrameRanges[i];
+    for (size_t j = 0; j < range.safePointCount; ++j) {
+      const StackFrameDescMapEntry & sp = range.safePoints[j];
+      if (GC_lookupStackFrameDesc(sp.instructionAddr) != sp.traceTable) {
+        fprintf(stderr, "Safe point %p not found in stack frame map\n", sp.instructionAddr);
+        ++missing;
       }
-    #endif
-  #else
-    #if SIZEOF_VOID_PTR == 4
-      __asm__("movl %%ebp, %0" :"=r"(framePtr));
-    #else
-      __asm__("movq %%rbp, %0" :"=r"(framePtr));
-    #endif
-  #endif
+    }
+  }
+
+  return missing;
+}
 
+void GC_traceFrames(CallFrame * framePtr, tart_object * traceAction) {
   while (framePtr != NULL) {
     void * returnAddr = framePtr->returnAddr;
     framePtr = framePtr->prevFrame;
@@ -0,0 +1,86 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+/* Wakeup signal for the finalizer thread.
+
+   The collector queues the finalizers of dead objects while the world is stopped, and
+   then calls GC_finalizerNotify. The finalizer thread is suspended while it waits in
+   GC_finalizerWait, so that collections never need to wait for it. After running every
+   queued finalizer it calls GC_finalizerDone, which releases any thread blocked in
+   GC_finalizerDrain. */
+
+#include "gc_common.h"
+
+#if HAVE_PTHREADS
+  #include <pthread.h>
+#endif
+
+extern "C" {
+  void GC_finalizerWait();
+  void GC_finalizerNotify();
+  void GC_finalizerDone();
+  void GC_finalizerDrain();
+}
+
+namespace {
+  // The number of calls to GC_finalizerNotify; the value of that count when the finalizer
+  // thread last woke up; and the value it had when the thread last emptied the queue.
+  uint64_t notifyCount;
+  uint64_t wakeCount;
+  uint64_t doneCount;
+
+  #if HAVE_PTHREADS
+    pthread_mutex_t finalizerLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t finalizerCond = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t finalizerDoneCond = PTHREAD_COND_INITIALIZER;
+  #endif
+}
+
+void GC_finalizerWait() {
+  #if HAVE_PTHREADS
+    CallFrame * framePtr;
+    GC_READ_FRAME_POINTER(framePtr);
+    GC_beginBlocking(framePtr);
+    pthread_mutex_lock(&finalizerLock);
+    while (wakeCount == notifyCount) {
+      pthread_cond_wait(&finalizerCond, &finalizerLock);
+    }
+    wakeCount = notifyCount;
+    pthread_mutex_unlock(&finalizerLock);
+    GC_endBlocking();
+  #endif
+}
+
+void GC_finalizerNotify() {
+  #if HAVE_PTHREADS
+    pthread_mutex_lock(&finalizerLock);
+    ++notifyCount;
+    pthread_cond_signal(&finalizerCond);
+    pthread_mutex_unlock(&finalizerLock);
+  #endif
+}
+
+void GC_finalizerDone() {
+  #if HAVE_PTHREADS
+    pthread_mutex_lock(&finalizerLock);
+    doneCount = wakeCount;
+    pthread_cond_broadcast(&finalizerDoneCond);
+    pthread_mutex_unlock(&finalizerLock);
+  #endif
+}
+
+void GC_finalizerDrain() {
+  #if HAVE_PTHREADS
+    CallFrame * framePtr;
+    GC_READ_FRAME_POINTER(framePtr);
+    GC_beginBlocking(framePtr);
+    pthread_mutex_lock(&finalizerLock);
+    uint64_t target = notifyCount;
+    while (doneCount < target) {
+      pthread_cond_wait(&finalizerDoneCond, &finalizerLock);
+    }
+    pthread_mutex_unlock(&finalizerLock);
+    GC_endBlocking();
+  #endif
+}
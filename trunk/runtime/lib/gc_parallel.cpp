@@ -0,0 +1,406 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+/* Support for parallel collection: a pool of worker threads, per-worker work-stealing
+   deques of grey objects, and the atomic operations needed to forward objects. */
+
+#include "gc_common.h"
+#include "tart_object.h"
+
+#if HAVE_STRING_H
+  #include <string.h>
+#endif
+
+#if HAVE_STDIO_H
+  #include <stdio.h>
+#endif
+
+#if HAVE_PTHREADS
+  #include <pthread.h>
+  #include <sched.h>
+#endif
+
+extern "C" {
+  intptr_t GC_parallelInit(intptr_t numThreads);
+  intptr_t GC_parallelThreadCount();
+  void GC_parallelRun(tart_object * task);
+  extern void ParallelTask_run(tart_object * task, intptr_t workerIndex);
+  void GC_workQueuePush(intptr_t worker, void * obj);
+  void * GC_workQueuePop(intptr_t worker);
+  bool GC_casWord(uint32_t * addr, uint32_t expected, uint32_t value);
+  uint32_t GC_loadAcquire(uint32_t * addr);
+  void GC_storeRelease(uint32_t * addr, uint32_t value);
+  void GC_lock();
+  void GC_unlock();
+}
+
+#if HAVE_PTHREADS
+namespace {
+  pthread_mutex_t gcLock = PTHREAD_MUTEX_INITIALIZER;
+}
+#endif
+
+#if HAVE_GCC_ATOMICS
+
+namespace {
+  static const intptr_t MAX_WORKERS = 64;
+  static const intptr_t INITIAL_DEQUE_SIZE = 4096;
+
+  /** Storage for a deque. When a deque grows, the old buffer is kept until the end of
+      the collection, since a thief may still be reading from it. */
+  struct WorkBuffer {
+    intptr_t mask;
+    WorkBuffer * retired;
+    void * items[1];
+  };
+
+  /** A Chase-Lev work-stealing deque. The owning worker pushes and pops at the bottom,
+      other workers steal from the top. */
+  struct WorkDeque {
+    volatile intptr_t top;
+    volatile intptr_t bottom;
+    WorkBuffer * volatile buffer;
+
+    // Keep each deque on its own cache line.
+    char padding[64 - 3 * sizeof(void *)];
+  };
+
+  WorkDeque deques[MAX_WORKERS];
+  intptr_t numWorkers = 1;
+
+  // Number of workers which have run out of work. When this reaches numWorkers, there
+  // is no work left anywhere and the trace is complete.
+  volatile intptr_t idleWorkers;
+
+  #if HAVE_PTHREADS
+    pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t startCond = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+    tart_object * currentTask;
+    size_t generation;
+    intptr_t pendingWorkers;
+  #endif
+}
+
+static WorkBuffer * GC_newWorkBuffer(intptr_t size) {
+  WorkBuffer * buf = (WorkBuffer *)malloc(sizeof(WorkBuffer) + (size - 1) * sizeof(void *));
+  if (buf == NULL) {
+    fprintf(stderr, "Unable to allocate collector work queue\n");
+    abort();
+  }
+  buf->mask = size - 1;
+  buf->retired = NULL;
+  return buf;
+}
+
+/** Replace the buffer of a full deque with one twice the size. */
+static WorkBuffer * GC_growDeque(WorkDeque * d, WorkBuffer * buf, intptr_t top, intptr_t bottom) {
+  WorkBuffer * newBuf = GC_newWorkBuffer((buf->mask + 1) * 2);
+  for (intptr_t i = top; i < bottom; ++i) {
+    newBuf->items[i & newBuf->mask] = buf->items[i & buf->mask];
+  }
+  newBuf->retired = buf;
+  __sync_synchronize();
+  d->buffer = newBuf;
+  return newBuf;
+}
+
+/** Take an item from the top of another worker's deque. */
+static void * GC_stealFrom(WorkDeque * d) {
+  intptr_t top = d->top;
+  __sync_synchronize();
+  intptr_t bottom = d->bottom;
+  if (top >= bottom) {
+    return NULL;
+  }
+
+  WorkBuffer * buf = d->buffer;
+  void * obj = buf->items[top & buf->mask];
+  if (!__sync_bool_compare_and_swap(&d->top, top, top + 1)) {
+    // Lost a race with the owner or another thief.
+    return NULL;
+  }
+  return obj;
+}
+
+/** Try to steal an item from any worker other than 'thief'. */
+static void * GC_stealAny(intptr_t thief) {
+  for (intptr_t i = 1; i < numWorkers; ++i) {
+    void * obj = GC_stealFrom(&deques[(thief + i) % numWorkers]);
+    if (obj != NULL) {
+      return obj;
+    }
+  }
+  return NULL;
+}
+
+/** Return true if any deque appears to have work in it. */
+static bool GC_anyWork() {
+  for (intptr_t i = 0; i < numWorkers; ++i) {
+    if (deques[i].top < deques[i].bottom) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Reset all deques at the end of a collection, and free any retired buffers. */
+static void GC_resetDeques() {
+  for (intptr_t i = 0; i < numWorkers; ++i) {
+    WorkDeque * d = &deques[i];
+    d->top = d->bottom = 0;
+    WorkBuffer * retired = d->buffer->retired;
+    d->buffer->retired = NULL;
+    while (retired != NULL) {
+      WorkBuffer * next = retired->retired;
+      free(retired);
+      retired = next;
+    }
+  }
+}
+
+#if HAVE_PTHREADS
+/** Main loop of a worker thread: wait for a task, run it, and report completion. */
+static void * GC_workerMain(void * arg) {
+  intptr_t workerIndex = (intptr_t)arg;
+  size_t seen = 0;
+  for (;;) {
+    pthread_mutex_lock(&poolLock);
+    while (generation == seen) {
+      pthread_cond_wait(&startCond, &poolLock);
+    }
+    seen = generation;
+    tart_object * task = currentTask;
+    pthread_mutex_unlock(&poolLock);
+
+    ParallelTask_run(task, workerIndex);
+
+    pthread_mutex_lock(&poolLock);
+    if (--pendingWorkers == 0) {
+      pthread_cond_signal(&doneCond);
+    }
+    pthread_mutex_unlock(&poolLock);
+  }
+  return NULL;
+}
+#endif
+
+intptr_t GC_parallelInit(intptr_t numThreads) {
+  if (numThreads > MAX_WORKERS) {
+    numThreads = MAX_WORKERS;
+  }
+  #if !HAVE_PTHREADS
+    numThreads = 1;
+  #endif
+
+  memset(deques, 0, sizeof(deques));
+  for (intptr_t i = 0; i < numThreads; ++i) {
+    deques[i].buffer = GC_newWorkBuffer(INITIAL_DEQUE_SIZE);
+  }
+
+  // The calling thread is always worker 0.
+  numWorkers = 1;
+  #if HAVE_PTHREADS
+    for (intptr_t i = 1; i < numThreads; ++i) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, GC_workerMain, (void *)i) != 0) {
+        break;
+      }
+      pthread_detach(thread);
+      ++numWorkers;
+    }
+  #endif
+  return numWorkers;
+}
+
+intptr_t GC_parallelThreadCount() {
+  return numWorkers;
+}
+
+void GC_parallelRun(tart_object * task) {
+  idleWorkers = 0;
+  #if HAVE_PTHREADS
+    if (numWorkers > 1) {
+      pthread_mutex_lock(&poolLock);
+      currentTask = task;
+      pendingWorkers = numWorkers - 1;
+      ++generation;
+      pthread_cond_broadcast(&startCond);
+      pthread_mutex_unlock(&poolLock);
+
+      ParallelTask_run(task, 0);
+
+      pthread_mutex_lock(&poolLock);
+      while (pendingWorkers > 0) {
+        pthread_cond_wait(&doneCond, &poolLock);
+      }
+      pthread_mutex_unlock(&poolLock);
+      GC_resetDeques();
+      return;
+    }
+  #endif
+
+  ParallelTask_run(task, 0);
+  GC_resetDeques();
+}
+
+void GC_workQueuePush(intptr_t worker, void * obj) {
+  WorkDeque * d = &deques[worker];
+  intptr_t bottom = d->bottom;
+  intptr_t top = d->top;
+  WorkBuffer * buf = d->buffer;
+  if (bottom - top > buf->mask) {
+    buf = GC_growDeque(d, buf, top, bottom);
+  }
+  buf->items[bottom & buf->mask] = obj;
+  __sync_synchronize();
+  d->bottom = bottom + 1;
+}
+
+void * GC_workQueuePop(intptr_t worker) {
+  WorkDeque * d = &deques[worker];
+
+  // Take from the bottom of our own deque.
+  intptr_t bottom = d->bottom - 1;
+  WorkBuffer * buf = d->buffer;
+  d->bottom = bottom;
+  __sync_synchronize();
+  intptr_t top = d->top;
+  if (top <= bottom) {
+    void * obj = buf->items[bottom & buf->mask];
+    if (top < bottom) {
+      return obj;
+    }
+
+    // This is the last item, so race the thieves for it.
+    bool won = __sync_bool_compare_and_swap(&d->top, top, top + 1);
+    d->bottom = bottom + 1;
+    if (won) {
+      return obj;
+    }
+  } else {
+    d->bottom = bottom + 1;
+  }
+
+  // Our deque is empty, so look for work elsewhere.
+  void * obj = GC_stealAny(worker);
+  if (obj != NULL) {
+    return obj;
+  }
+
+  // Go idle. A worker only pushes work while it is busy, so once every worker is idle
+  // there can be no more work.
+  __sync_fetch_and_add(&idleWorkers, 1);
+  for (;;) {
+    if (idleWorkers == numWorkers) {
+      return NULL;
+    }
+
+    if (GC_anyWork()) {
+      __sync_fetch_and_sub(&idleWorkers, 1);
+      obj = GC_stealAny(worker);
+      if (obj != NULL) {
+        return obj;
+      }
+      __sync_fetch_and_add(&idleWorkers, 1);
+    }
+
+    #if HAVE_PTHREADS
+      sched_yield();
+    #endif
+  }
+}
+
+// The atomic operations work on 32-bit words, to match the 'gcstate' field of the
+// object header and the words of the mark bitmap. A wider access would also touch the
+// field which follows 'gcstate'.
+
+bool GC_casWord(uint32_t * addr, uint32_t expected, uint32_t value) {
+  return __sync_bool_compare_and_swap(addr, expected, value);
+}
+
+uint32_t GC_loadAcquire(uint32_t * addr) {
+  uint32_t value = *(volatile uint32_t *)addr;
+  __sync_synchronize();
+  return value;
+}
+
+void GC_storeRelease(uint32_t * addr, uint32_t value) {
+  __sync_synchronize();
+  *(volatile uint32_t *)addr = value;
+}
+
+#else
+
+// Without atomic builtins there is a single worker, so the collector runs serially. The
+// work queue is a plain stack, and the 'atomic' operations need no synchronization.
+
+namespace {
+  void ** workStack;
+  intptr_t workStackSize;
+  intptr_t workStackCapacity;
+}
+
+intptr_t GC_parallelInit(intptr_t numThreads) {
+  (void)numThreads;
+  return 1;
+}
+
+intptr_t GC_parallelThreadCount() {
+  return 1;
+}
+
+void GC_parallelRun(tart_object * task) {
+  ParallelTask_run(task, 0);
+}
+
+void GC_workQueuePush(intptr_t worker, void * obj) {
+  (void)worker;
+  if (workStackSize == workStackCapacity) {
+    intptr_t capacity = workStackCapacity != 0 ? workStackCapacity * 2 : 4096;
+    void ** stack = (void **)realloc(workStack, capacity * sizeof(void *));
+    if (stack == NULL) {
+      fprintf(stderr, "Unable to allocate collector work queue\n");
+      abort();
+    }
+    workStack = stack;
+    workStackCapacity = capacity;
+  }
+  workStack[workStackSize++] = obj;
+}
+
+void * GC_workQueuePop(intptr_t worker) {
+  (void)worker;
+  return workStackSize > 0 ? workStack[--workStackSize] : NULL;
+}
+
+bool GC_casWord(uint32_t * addr, uint32_t expected, uint32_t value) {
+  if (*addr != expected) {
+    return false;
+  }
+  *addr = value;
+  return true;
+}
+
+uint32_t GC_loadAcquire(uint32_t * addr) {
+  return *addr;
+}
+
+void GC_storeRelease(uint32_t * addr, uint32_t value) {
+  *addr = value;
+}
+
+#endif
+
+void GC_lock() {
+  #if HAVE_PTHREADS
+    pthread_mutex_lock(&gcLock);
+  #endif
+}
+
+void GC_unlock() {
+  #if HAVE_PTHREADS
+    pthread_mutex_unlock(&gcLock);
+  #endif
+}
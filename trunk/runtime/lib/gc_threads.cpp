@@ -0,0 +1,392 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+/* Registry of mutator threads, and the stop-the-world safepoint protocol.
+
+   Compiled code polls GC_safepointRequested at function entry and at loop back-edges,
+   and calls GC_safepoint() if it is set. A thread that wants to collect takes the heap
+   lock, sets the flag, and waits until every other registered thread has either stopped
+   at a safepoint, or is suspended in a blocking operation. Each stopped thread records
+   a frame pointer which stays valid until it resumes, so that the collector can trace
+   its stack. */
+
+#include "gc_common.h"
+#include "tart_object.h"
+
+#if HAVE_STDIO_H
+  #include <stdio.h>
+#endif
+
+#if HAVE_PTHREADS
+  #include <pthread.h>
+  #include <sched.h>
+#endif
+
+extern "C" {
+  extern volatile int32_t GC_safepointRequested;
+  void GC_registerThread();
+  void GC_unregisterThread();
+  void GC_safepoint();
+  void GC_suspendThread();
+  void GC_resumeThread();
+  void GC_stopTheWorld();
+  void GC_resumeTheWorld();
+  void GC_lockHeap();
+  void GC_unlockHeap();
+  void GC_traceStack(tart_object * action);
+  void * GC_threadStart(tart_object * thread);
+  void GC_threadJoin(void * handle);
+  extern void TraceAction_traceDescriptors(tart_object * action,
+      void * baseAddr, TraceDescriptor * traceTable);
+  extern void Thread_run(tart_object * thread);
+  extern void GC_exitThread();
+}
+
+/** Set while a thread is waiting to collect. Polled by compiled code. */
+volatile int32_t GC_safepointRequested = 0;
+
+namespace {
+  enum ThreadState {
+    THREAD_RUNNING,     // Running compiled code; must reach a safepoint before collecting.
+    THREAD_STOPPED,     // Waiting at a safepoint.
+    THREAD_SUSPENDED,   // In a blocking operation, will not touch the heap.
+  };
+
+  struct GCThread {
+    GCThread * next;
+
+    /** Frame pointer of the most recent call into the runtime, valid unless running. */
+    CallFrame * topFrame;
+    ThreadState state;
+
+    /** For a thread suspended by GC_suspendThread, a copy of the frame record from which
+        its stack is traced. */
+    CallFrame suspendedFrame;
+
+    /** For threads started by GC_threadStart, the thread object, until the thread has
+        begun running. This is traced as a root, since the object may move. */
+    tart_object * startObject;
+
+    /** True if this thread was created by GC_threadStart. */
+    bool joinable;
+
+    #if HAVE_PTHREADS
+      pthread_t handle;
+    #endif
+  };
+
+  // Trace descriptor for the 'startObject' field.
+  intptr_t startObjectOffsets[] = { 0 };
+  TraceDescriptor startObjectDesc = { 1, 1, 0, { startObjectOffsets } };
+
+  // List of registered threads.
+  GCThread * threads;
+
+  // The thread that is currently collecting, if any.
+  GCThread * collector;
+
+  #if HAVE_GCC_THREAD_LOCAL
+    __thread GCThread * currentThread;
+  #elif HAVE_MSVC_THREAD_LOCAL
+    __declspec(thread) GCThread * currentThread;
+  #else
+    #error No thread-local support for platform.
+  #endif
+
+  #if HAVE_PTHREADS
+    pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t threadStopped = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t worldResumed = PTHREAD_COND_INITIALIZER;
+    pthread_mutex_t heapLock = PTHREAD_MUTEX_INITIALIZER;
+  #endif
+}
+
+static void GC_lockRegistry() {
+  #if HAVE_PTHREADS
+    pthread_mutex_lock(&registryLock);
+  #endif
+}
+
+static void GC_unlockRegistry() {
+  #if HAVE_PTHREADS
+    pthread_mutex_unlock(&registryLock);
+  #endif
+}
+
+/** Wait, with the registry locked, until the current collection has finished. */
+static void GC_waitForCollection() {
+  #if HAVE_PTHREADS
+    while (GC_safepointRequested) {
+      pthread_cond_wait(&worldResumed, &registryLock);
+    }
+  #endif
+}
+
+/** Stop the current thread, with the registry locked, until the current collection has
+    finished. 'framePtr' is the frame from which the thread's stack will be traced. */
+static void GC_park(GCThread * self, CallFrame * framePtr) {
+  ThreadState prevState = self->state;
+  self->topFrame = framePtr;
+  self->state = THREAD_STOPPED;
+  #if HAVE_PTHREADS
+    pthread_cond_signal(&threadStopped);
+  #endif
+  GC_waitForCollection();
+  self->state = prevState;
+}
+
+/** Add a thread record to the registry, with the registry locked. */
+static void GC_addThread(GCThread * thread) {
+  thread->next = threads;
+  threads = thread;
+}
+
+/** Remove a thread record from the registry, with the registry locked. */
+static void GC_removeThread(GCThread * thread) {
+  for (GCThread ** link = &threads; *link != NULL; link = &(*link)->next) {
+    if (*link == thread) {
+      *link = thread->next;
+      break;
+    }
+  }
+
+  // The collector may be waiting for this thread to stop.
+  #if HAVE_PTHREADS
+    pthread_cond_signal(&threadStopped);
+  #endif
+}
+
+void GC_registerThread() {
+  if (currentThread != NULL) {
+    return;
+  }
+
+  GCThread * self = new GCThread();
+  self->topFrame = NULL;
+  self->state = THREAD_RUNNING;
+  self->startObject = NULL;
+  self->joinable = false;
+  currentThread = self;
+
+  GC_lockRegistry();
+  GC_waitForCollection();
+  GC_addThread(self);
+  GC_unlockRegistry();
+}
+
+void GC_unregisterThread() {
+  GCThread * self = currentThread;
+  if (self == NULL) {
+    return;
+  }
+
+  GC_lockRegistry();
+  GC_removeThread(self);
+  GC_unlockRegistry();
+  currentThread = NULL;
+
+  // Records for threads created by GC_threadStart are freed by GC_threadJoin.
+  if (!self->joinable) {
+    delete self;
+  }
+}
+
+void GC_safepoint() {
+  GCThread * self = currentThread;
+  if (self == NULL || self == collector) {
+    return;
+  }
+
+  CallFrame * framePtr;
+  GC_READ_FRAME_POINTER(framePtr);
+  GC_lockRegistry();
+  if (GC_safepointRequested) {
+    GC_park(self, framePtr);
+  }
+  GC_unlockRegistry();
+}
+
+void GC_beginBlocking(CallFrame * framePtr) {
+  GCThread * self = currentThread;
+  if (self == NULL) {
+    return;
+  }
+
+  GC_lockRegistry();
+  self->topFrame = framePtr;
+  self->state = THREAD_SUSPENDED;
+  #if HAVE_PTHREADS
+    pthread_cond_signal(&threadStopped);
+  #endif
+  GC_unlockRegistry();
+}
+
+void GC_endBlocking() {
+  GCThread * self = currentThread;
+  if (self == NULL) {
+    return;
+  }
+
+  GC_lockRegistry();
+  GC_waitForCollection();
+  self->state = THREAD_RUNNING;
+  GC_unlockRegistry();
+}
+
+void GC_suspendThread() {
+  GCThread * self = currentThread;
+  if (self == NULL) {
+    return;
+  }
+
+  // Both this function and its caller, GC_suspend, return before the blocking operation
+  // starts, so neither frame can be traced. GC_suspend's frame record links to the frame
+  // of the function that called GC.suspend() and to the return address within it, both
+  // of which stay valid until GC.resume() is called, so trace the stack from a copy.
+  CallFrame * framePtr;
+  GC_READ_FRAME_POINTER(framePtr);
+  self->suspendedFrame = *framePtr->prevFrame;
+  GC_beginBlocking(&self->suspendedFrame);
+}
+
+void GC_resumeThread() {
+  GC_endBlocking();
+}
+
+/** Return true if every thread other than 'self' is stopped or suspended. */
+static bool GC_allThreadsStopped(GCThread * self) {
+  for (GCThread * t = threads; t != NULL; t = t->next) {
+    if (t != self && t->state == THREAD_RUNNING) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GC_stopTheWorld() {
+  // Only the holder of the heap lock collects, so there is never more than one collector.
+  GC_lockRegistry();
+  GC_safepointRequested = 1;
+  collector = currentThread;
+  #if HAVE_PTHREADS
+    while (!GC_allThreadsStopped(collector)) {
+      pthread_cond_wait(&threadStopped, &registryLock);
+    }
+  #endif
+  GC_unlockRegistry();
+}
+
+void GC_resumeTheWorld() {
+  GC_lockRegistry();
+  collector = NULL;
+  GC_safepointRequested = 0;
+  #if HAVE_PTHREADS
+    pthread_cond_broadcast(&worldResumed);
+  #endif
+  GC_unlockRegistry();
+}
+
+void GC_lockHeap() {
+  #if HAVE_PTHREADS
+    // The thread that holds the lock may be collecting, so keep responding to safepoint
+    // requests while waiting for it.
+    while (pthread_mutex_trylock(&heapLock) != 0) {
+      if (GC_safepointRequested) {
+        GC_safepoint();
+      } else {
+        sched_yield();
+      }
+    }
+  #endif
+}
+
+void GC_unlockHeap() {
+  #if HAVE_PTHREADS
+    pthread_mutex_unlock(&heapLock);
+  #endif
+}
+
+void GC_traceStack(tart_object * traceAction) {
+  // The calling thread's stack is traced from here.
+  CallFrame * framePtr;
+  GC_READ_FRAME_POINTER(framePtr);
+  GCThread * self = currentThread;
+  GC_traceFrames(framePtr, traceAction);
+
+  // Every other thread is stopped, so the list can be read without locking.
+  for (GCThread * t = threads; t != NULL; t = t->next) {
+    if (t == self) {
+      continue;
+    }
+    if (t->startObject != NULL) {
+      TraceAction_traceDescriptors(traceAction, &t->startObject, &startObjectDesc);
+    }
+    GC_traceFrames(t->topFrame, traceAction);
+  }
+}
+
+#if HAVE_PTHREADS
+/** Entry point for threads created by GC_threadStart. */
+static void * GC_threadMain(void * arg) {
+  GCThread * self = (GCThread *)arg;
+  currentThread = self;
+
+  // The thread object may have moved since the thread was created. Fetch it once the
+  // thread is running, after which no collection can happen until it reaches a safepoint.
+  GC_lockRegistry();
+  GC_waitForCollection();
+  self->state = THREAD_RUNNING;
+  tart_object * thread = self->startObject;
+  self->startObject = NULL;
+  GC_unlockRegistry();
+
+  Thread_run(thread);
+
+  // Free the thread's allocation context as well as unregistering it.
+  GC_exitThread();
+  return NULL;
+}
+#endif
+
+void * GC_threadStart(tart_object * thread) {
+  #if HAVE_PTHREADS
+    // The new thread starts out suspended, so that collections need not wait for it.
+    GCThread * child = new GCThread();
+    child->topFrame = NULL;
+    child->state = THREAD_SUSPENDED;
+    child->startObject = thread;
+    child->joinable = true;
+
+    GC_lockRegistry();
+    GC_addThread(child);
+    GC_unlockRegistry();
+
+    if (pthread_create(&child->handle, NULL, GC_threadMain, child) != 0) {
+      fprintf(stderr, "Unable to create thread\n");
+      abort();
+    }
+    return child;
+  #else
+    (void)thread;
+    fprintf(stderr, "Threads are not supported on this platform\n");
+    abort();
+    return NULL;
+  #endif
+}
+
+void GC_threadJoin(void * handle) {
+  #if HAVE_PTHREADS
+    // Let collections proceed while waiting. This frame stays on the stack until the
+    // wait is over, so the stack can be traced from here.
+    CallFrame * framePtr;
+    GC_READ_FRAME_POINTER(framePtr);
+    GCThread * child = (GCThread *)handle;
+    GC_beginBlocking(framePtr);
+    pthread_join(child->handle, NULL);
+    GC_endBlocking();
+    delete child;
+  #else
+    (void)handle;
+  #endif
+}
@@ -50,13 +50,16 @@ struct Type;
 
 // Every Tart object begins with a pointer to a TIB (TypeInfoBlock) which contains the
 // method table and other type information. The list of base classes is a NULL-terminated
-// list of type pointers.
+// list of type pointers. For classes, the display lists the superclasses in order of
+// depth, ending with the class itself. Only the leading fields which are used here are
+// declared; they must match the layout in tart/Gen/TypeInfoBlock.h.
 struct TypeInfoBlock {
   void * meta;
   void * traceTable;
   const struct TypeInfoBlock * const * bases;
-  void ** interfaceTable;
-  // void ** methodTable;
+  const struct TypeInfoBlock * const * display;
+  uint64_t interfaceBits;
+  int32_t depth;
 };
 
 // Description of a stack frame.
@@ -108,6 +111,11 @@ static bool hasBase(const struct TypeInfoBlock * tib, const struct TypeInfoBlock
     return true;
   }
 
+  // Exception types are classes, which can be found in the display.
+  if (type->depth >= 0) {
+    return type->depth <= tib->depth && tib->display[type->depth] == type;
+  }
+
   const struct TypeInfoBlock * const * bases = tib->bases;
   const struct TypeInfoBlock * base;
   while ((base = *bases++) != NULL) {
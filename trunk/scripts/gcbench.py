@@ -0,0 +1,55 @@
+#!/usr/bin/python3
+
+# Runs the collector benchmark (test/bench/GCBench) with increasing numbers of
+# collector threads, and prints how the full collection pause time scales.
+#
+# Usage: gcbench.py <path to GCBench> [max threads]
+
+import multiprocessing
+import os
+import re
+import subprocess
+import sys
+
+re_result = re.compile(r"(\w+): (\d+)")
+
+def run(exe, threads):
+  env = dict(os.environ)
+  env["TART_GC_THREADS"] = str(threads)
+  output = subprocess.check_output([exe], env=env, stderr=subprocess.STDOUT)
+  results = {}
+  for line in output.decode().splitlines():
+    m = re_result.match(line.strip())
+    if m:
+      results[m.group(1)] = int(m.group(2))
+  return results
+
+def main():
+  if len(sys.argv) < 2:
+    sys.stderr.write("Usage: gcbench.py <GCBench executable> [max threads]\n")
+    sys.exit(1)
+  exe = sys.argv[1]
+  maxThreads = multiprocessing.cpu_count()
+  if len(sys.argv) > 2:
+    maxThreads = int(sys.argv[2])
+
+  threadCounts = []
+  n = 1
+  while n < maxThreads:
+    threadCounts.append(n)
+    n *= 2
+  threadCounts.append(maxThreads)
+
+  print("{0:>8} {1:>12} {2:>12} {3:>12} {4:>8}".format(
+      "threads", "min (us)", "avg (us)", "max (us)", "speedup"))
+  baseline = None
+  for threads in threadCounts:
+    r = run(exe, threads)
+    avg = r["pause_avg_us"]
+    if baseline is None:
+      baseline = avg
+    print("{0:>8} {1:>12} {2:>12} {3:>12} {4:>8.2f}".format(
+        threads, r["pause_min_us"], avg, r["pause_max_us"], float(baseline) / max(avg, 1)))
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,53 @@
+# Script for the -j test: run tartc on the test files and check its results.
+# Expects TARTC, SRCDIR and MODPATH to be defined.
+
+set(BAD_FILES BadA.tart BadB.tart)
+foreach (FILE ${BAD_FILES})
+  set(ERRORS_${FILE} 0)
+endforeach (FILE)
+
+file(REMOVE Good.bc)
+execute_process(
+    COMMAND ${TARTC} -nostdlib -j2 -sourcepath ${SRCDIR} -i ${MODPATH}
+        Good.tart ${BAD_FILES}
+    RESULT_VARIABLE STATUS
+    OUTPUT_VARIABLE OUTPUT
+    ERROR_VARIABLE OUTPUT)
+message("${OUTPUT}")
+
+if (STATUS EQUAL 0)
+  message(FATAL_ERROR "tartc -j2 succeeded, but two of the files have errors")
+endif (STATUS EQUAL 0)
+
+if (NOT EXISTS Good.bc)
+  message(FATAL_ERROR "Good.tart was not compiled")
+endif (NOT EXISTS Good.bc)
+
+# Collapse the file named by each line of output into a list of runs. If the output of
+# each job is printed together, each file with errors appears in exactly one run.
+string(REPLACE "\n" ";" LINES "${OUTPUT}")
+set(RUNS)
+set(LAST)
+foreach (LINE ${LINES})
+  foreach (FILE ${BAD_FILES})
+    if (LINE MATCHES "${FILE}")
+      if (NOT FILE STREQUAL LAST)
+        list(APPEND RUNS ${FILE})
+        set(LAST ${FILE})
+      endif (NOT FILE STREQUAL LAST)
+      math(EXPR ERRORS_${FILE} "${ERRORS_${FILE}} + 1")
+    endif (LINE MATCHES "${FILE}")
+  endforeach (FILE)
+endforeach (LINE)
+
+foreach (FILE ${BAD_FILES})
+  if (NOT ERRORS_${FILE} GREATER 1)
+    message(FATAL_ERROR "Expected two errors for ${FILE}")
+  endif (NOT ERRORS_${FILE} GREATER 1)
+endforeach (FILE)
+
+list(LENGTH RUNS RUN_COUNT)
+list(LENGTH BAD_FILES FILE_COUNT)
+if (NOT RUN_COUNT EQUAL FILE_COUNT)
+  message(FATAL_ERROR "The output for different files is interleaved")
+endif (NOT RUN_COUNT EQUAL FILE_COUNT)
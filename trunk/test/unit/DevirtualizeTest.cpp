@@ -0,0 +1,151 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include <gtest/gtest.h>
+#include "tart/Opt/Devirtualize.h"
+
+#include "llvm/Module.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/ADT/OwningPtr.h"
+
+using namespace tart;
+using namespace llvm;
+
+namespace {
+
+// A closed hierarchy in the form the compiler emits it: Base has a subclass Derived which
+// overrides method 0, and Final has no subclasses. Only the TIB fields which the pass
+// reads are filled in.
+const char * hierarchy =
+  "%TIB = type { i8*, i8*, i8*, i8*, i64, i32, i8*, i8*, i32, [1 x i8*] }\n"
+  "%Object = type { %TIB* }\n"
+  "\n"
+  "@Object.TIB = constant %TIB { i8* null, i8* null, i8* null,\n"
+  "    i8* bitcast ([1 x i8*]* @Object.display to i8*), i64 0, i32 0, i8* null, i8* null,\n"
+  "    i32 0, [1 x i8*] [i8* null] }\n"
+  "@Object.display = constant [1 x i8*] [i8* bitcast (%TIB* @Object.TIB to i8*)]\n"
+  "\n"
+  "@Base.TIB = constant %TIB { i8* null, i8* null, i8* null,\n"
+  "    i8* bitcast ([2 x i8*]* @Base.display to i8*), i64 0, i32 1, i8* null, i8* null,\n"
+  "    i32 0, [1 x i8*] [i8* bitcast (void (%Object*)* @Base.run to i8*)] }\n"
+  "@Base.display = constant [2 x i8*] [i8* bitcast (%TIB* @Object.TIB to i8*),\n"
+  "    i8* bitcast (%TIB* @Base.TIB to i8*)]\n"
+  "\n"
+  "@Derived.TIB = constant %TIB { i8* null, i8* null, i8* null,\n"
+  "    i8* bitcast ([3 x i8*]* @Derived.display to i8*), i64 0, i32 2, i8* null, i8* null,\n"
+  "    i32 0, [1 x i8*] [i8* bitcast (void (%Object*)* @Derived.run to i8*)] }\n"
+  "@Derived.display = constant [3 x i8*] [i8* bitcast (%TIB* @Object.TIB to i8*),\n"
+  "    i8* bitcast (%TIB* @Base.TIB to i8*), i8* bitcast (%TIB* @Derived.TIB to i8*)]\n"
+  "\n"
+  "@Final.TIB = constant %TIB { i8* null, i8* null, i8* null,\n"
+  "    i8* bitcast ([2 x i8*]* @Final.display to i8*), i64 0, i32 1, i8* null, i8* null,\n"
+  "    i32 0, [1 x i8*] [i8* bitcast (void (%Object*)* @Final.run to i8*)] }\n"
+  "@Final.display = constant [2 x i8*] [i8* bitcast (%TIB* @Object.TIB to i8*),\n"
+  "    i8* bitcast (%TIB* @Final.TIB to i8*)]\n"
+  "\n"
+  "define void @Base.run(%Object* %self) { ret void }\n"
+  "define void @Derived.run(%Object* %self) { ret void }\n"
+  "define void @Final.run(%Object* %self) { ret void }\n"
+  "\n"
+  "!0 = metadata !{metadata !\"Base.TIB\", i32 0}\n"
+  "!1 = metadata !{metadata !\"Final.TIB\", i32 0}\n";
+
+// A virtual call of method 0 on 'obj', whose static class is given by metadata 'md'.
+std::string virtualCall(const char * name, const char * md) {
+  return std::string("define void @") + name + "(%Object* %obj) {\n"
+    "  %tibaddr = getelementptr inbounds %Object* %obj, i32 0, i32 0\n"
+    "  %tib = load %TIB** %tibaddr\n"
+    "  %slot = getelementptr inbounds %TIB* %tib, i32 0, i32 9, i32 0\n"
+    "  %fptr = load i8** %slot\n"
+    "  %method = bitcast i8* %fptr to void (%Object*)*, !tart.vcall " + md + "\n"
+    "  call void %method(%Object* %obj)\n"
+    "  ret void\n"
+    "}\n";
+}
+
+// Parse 'source' and run the devirtualization pass over it.
+Module * devirtualize(const std::string & source) {
+  SMDiagnostic error;
+  Module * module = ParseAssemblyString(
+      source.c_str(), NULL, error, getGlobalContext());
+  if (module == NULL) {
+    error.Print("DevirtualizeTest", errs());
+    return NULL;
+  }
+
+  Devirtualize pass;
+  pass.runOnModule(*module);
+  return module;
+}
+
+// Return the function called by the first call instruction in 'fnName'.
+const Value * callee(Module * module, const char * fnName) {
+  Function * fn = module->getFunction(fnName);
+  for (Function::iterator bb = fn->begin(); bb != fn->end(); ++bb) {
+    for (BasicBlock::iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+      if (CallInst * call = dyn_cast<CallInst>(inst)) {
+        return call->getCalledValue()->stripPointerCasts();
+      }
+    }
+  }
+
+  return NULL;
+}
+
+}
+
+TEST(DevirtualizeTest, FinalClass) {
+  OwningPtr<Module> module(devirtualize(
+      std::string(hierarchy) + virtualCall("callFinal", "!1")));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_EQ(module->getFunction("Final.run"), callee(module.get(), "callFinal"));
+}
+
+TEST(DevirtualizeTest, OverriddenMethod) {
+  // Either Base.run or Derived.run could be called, so the lookup must stay.
+  OwningPtr<Module> module(devirtualize(
+      std::string(hierarchy) + virtualCall("callBase", "!0")));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_FALSE(isa<Function>(callee(module.get(), "callBase")));
+}
+
+TEST(DevirtualizeTest, ExactReceiver) {
+  // The method is loaded from a constant TIB, so the receiver is known to be a Derived,
+  // even though the call's static class is Base.
+  OwningPtr<Module> module(devirtualize(std::string(hierarchy) +
+    "define void @callExact(%Object* %obj) {\n"
+    "  %fptr = load i8** getelementptr inbounds (%TIB* @Derived.TIB, i32 0, i32 9, i32 0)\n"
+    "  %method = bitcast i8* %fptr to void (%Object*)*, !tart.vcall !0\n"
+    "  call void %method(%Object* %obj)\n"
+    "  ret void\n"
+    "}\n"));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_EQ(module->getFunction("Derived.run"), callee(module.get(), "callExact"));
+}
+
+TEST(DevirtualizeTest, ConstantReceiver) {
+  // A constant object's TIB is known, so calls on it are resolved from its exact class.
+  OwningPtr<Module> module(devirtualize(std::string(hierarchy) +
+    "@derived = constant %Object { %TIB* @Derived.TIB }\n" +
+    "define void @callConstant() {\n"
+    "  %tib = load %TIB** getelementptr inbounds (%Object* @derived, i32 0, i32 0)\n"
+    "  %slot = getelementptr inbounds %TIB* %tib, i32 0, i32 9, i32 0\n"
+    "  %fptr = load i8** %slot\n"
+    "  %method = bitcast i8* %fptr to void (%Object*)*, !tart.vcall !0\n"
+    "  call void %method(%Object* @derived)\n"
+    "  ret void\n"
+    "}\n"));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_EQ(module->getFunction("Derived.run"), callee(module.get(), "callConstant"));
+}
+
+TEST(DevirtualizeTest, OpenHierarchy) {
+  // A TIB that is only declared may have subclasses outside of the module.
+  OwningPtr<Module> module(devirtualize(std::string(hierarchy) +
+    "@Other.TIB = external constant %TIB\n" + virtualCall("callFinal", "!1")));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_FALSE(isa<Function>(callee(module.get(), "callFinal")));
+}
@@ -0,0 +1,127 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include <gtest/gtest.h>
+#include "tart/Common/GC.h"
+
+using namespace tart;
+
+namespace {
+
+// An object which is allocated in the current arena, if there is one, and counts how
+// many instances have been destroyed.
+class ArenaObject : public GC {
+public:
+  ArenaObject(ArenaObject * ref = NULL) : ref_(ref) {}
+  ~ArenaObject() { ++destroyed; }
+
+  void * operator new(size_t size) { return GC::arenaAlloc(size); }
+  void trace() const { safeMark(ref_); }
+
+  ArenaObject * ref_;
+  static int destroyed;
+};
+
+int ArenaObject::destroyed = 0;
+
+// Roots are never unregistered, so the tests share a single one.
+class TestRoot : public GCRootBase {
+public:
+  TestRoot() : ptr(NULL) {}
+  void trace() const { GC::safeMark(ptr); }
+
+  ArenaObject * ptr;
+};
+
+TestRoot root;
+
+}
+
+TEST(GCArenaTest, ReleasedArena) {
+  GCArena * arena = new GCArena();
+  {
+    GCArena::Scope arenaScope(arena);
+    new ArenaObject(new ArenaObject());
+    new ArenaObject();
+  }
+
+  // An arena which is still in use is kept, even though nothing refers to it.
+  ArenaObject::destroyed = 0;
+  GC::sweep();
+  EXPECT_EQ(0, ArenaObject::destroyed);
+
+  arena->release();
+  GC::sweep();
+  EXPECT_EQ(3, ArenaObject::destroyed);
+}
+
+TEST(GCArenaTest, PinnedArena) {
+  GCArena * arena = new GCArena();
+  {
+    GCArena::Scope arenaScope(arena);
+    new ArenaObject();
+    root.ptr = new ArenaObject();
+  }
+
+  // One reachable object keeps the whole arena alive.
+  ArenaObject::destroyed = 0;
+  arena->release();
+  GC::sweep();
+  EXPECT_EQ(0, ArenaObject::destroyed);
+
+  root.ptr = NULL;
+  GC::sweep();
+  EXPECT_EQ(2, ArenaObject::destroyed);
+}
+
+TEST(GCArenaTest, NestedScopes) {
+  GCArena * outer = new GCArena();
+  GCArena * inner = new GCArena();
+  EXPECT_TRUE(GCArena::current() == NULL);
+  {
+    GCArena::Scope outerScope(outer);
+    new ArenaObject();
+    {
+      GCArena::Scope innerScope(inner);
+      EXPECT_EQ(inner, GCArena::current());
+      new ArenaObject();
+    }
+
+    EXPECT_EQ(outer, GCArena::current());
+    new ArenaObject();
+  }
+  EXPECT_TRUE(GCArena::current() == NULL);
+
+  // Only the object allocated in the inner scope belongs to the inner arena.
+  ArenaObject::destroyed = 0;
+  inner->release();
+  GC::sweep();
+  EXPECT_EQ(1, ArenaObject::destroyed);
+
+  outer->release();
+  GC::sweep();
+  EXPECT_EQ(3, ArenaObject::destroyed);
+}
+
+TEST(GCArenaTest, CycleWrapAround) {
+  // An object which became unreachable keeps its last mark for as long as its arena
+  // is in use. Once the cycle index has come all the way around to that mark again,
+  // the object must not look reachable.
+  GCArena * arena = new GCArena();
+  {
+    GCArena::Scope arenaScope(arena);
+    root.ptr = new ArenaObject();
+  }
+
+  GC::sweep();
+  root.ptr = NULL;
+  for (int i = 0; i < 254; ++i) {
+    GC::sweep();
+  }
+
+  ArenaObject::destroyed = 0;
+  arena->release();
+  GC::sweep();
+  EXPECT_EQ(1, ArenaObject::destroyed);
+}
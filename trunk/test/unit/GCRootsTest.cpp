@@ -0,0 +1,189 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include <gtest/gtest.h>
+#include "tart/GC/GCStrategy.h"
+
+#include "llvm/Module.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/ADT/OwningPtr.h"
+
+using namespace tart;
+using namespace llvm;
+
+namespace {
+
+const char * declarations =
+  "%Object = type { i8* }\n"
+  "declare void @llvm.gcroot(i8**, i8*)\n"
+  "declare %Object* @make()\n"
+  "declare void @use(%Object*)\n"
+  "declare i1 @more()\n";
+
+// The declaration of root 'name', in the form the compiler emits it, including the
+// initializer added by the collector strategy.
+std::string root(const char * name) {
+  return std::string("  %") + name + " = alloca %Object*\n"
+    "  %" + name + ".rptr = bitcast %Object** %" + name + " to i8**\n"
+    "  call void @llvm.gcroot(i8** %" + name + ".rptr, i8* null)\n"
+    "  store %Object* null, %Object** %" + name + "\n";
+}
+
+// Parse 'source' and run root optimization over the function 'fnName'.
+Module * optimizeRoots(const std::string & source, const char * fnName) {
+  SMDiagnostic error;
+  Module * module = ParseAssemblyString(
+      source.c_str(), NULL, error, getGlobalContext());
+  if (module == NULL) {
+    error.Print("GCRootsTest", errs());
+    return NULL;
+  }
+
+  Function * fn = module->getFunction(fnName);
+  SmallVector<AllocaInst *, 8> roots;
+  for (Function::iterator bb = fn->begin(); bb != fn->end(); ++bb) {
+    for (BasicBlock::iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+      if (IntrinsicInst * ii = dyn_cast<IntrinsicInst>(inst)) {
+        if (ii->getIntrinsicID() == Intrinsic::gcroot) {
+          roots.push_back(cast<AllocaInst>(ii->getArgOperand(0)->stripPointerCasts()));
+        }
+      }
+    }
+  }
+
+  TartGCStrategy strategy;
+  strategy.optimizeRoots(*fn, roots);
+  return module;
+}
+
+// Return the allocas which are still marked as roots in 'fnName'.
+std::vector<std::string> markedRoots(Module * module, const char * fnName) {
+  std::vector<std::string> result;
+  Function * fn = module->getFunction(fnName);
+  for (Function::iterator bb = fn->begin(); bb != fn->end(); ++bb) {
+    for (BasicBlock::iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+      if (IntrinsicInst * ii = dyn_cast<IntrinsicInst>(inst)) {
+        if (ii->getIntrinsicID() == Intrinsic::gcroot) {
+          result.push_back(ii->getArgOperand(0)->stripPointerCasts()->getName().str());
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+// Return the number of allocas in 'fnName'.
+unsigned allocaCount(Module * module, const char * fnName) {
+  unsigned count = 0;
+  Function * fn = module->getFunction(fnName);
+  for (Function::iterator bb = fn->begin(); bb != fn->end(); ++bb) {
+    for (BasicBlock::iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+      if (isa<AllocaInst>(inst)) {
+        ++count;
+      }
+    }
+  }
+
+  return count;
+}
+
+}
+
+TEST(GCRootsTest, LiveAcrossCall) {
+  OwningPtr<Module> module(optimizeRoots(std::string(declarations) +
+    "define void @f() gc \"tart-gc\" {\n" + root("a") +
+    "  %obj = call %Object* @make()\n"
+    "  store %Object* %obj, %Object** %a\n"
+    "  call void @use(%Object* null)\n"
+    "  %v = load %Object** %a\n"
+    "  call void @use(%Object* %v)\n"
+    "  ret void\n"
+    "}\n", "f"));
+  ASSERT_TRUE(module.get() != NULL);
+  std::vector<std::string> marked = markedRoots(module.get(), "f");
+  ASSERT_EQ(1u, marked.size());
+  EXPECT_EQ("a", marked[0]);
+}
+
+TEST(GCRootsTest, DisjointRootsShareSlot) {
+  // 'a' is dead by the time 'b' is stored, so they can use the same stack slot.
+  OwningPtr<Module> module(optimizeRoots(std::string(declarations) +
+    "define void @f() gc \"tart-gc\" {\n" + root("a") + root("b") +
+    "  %obj1 = call %Object* @make()\n"
+    "  store %Object* %obj1, %Object** %a\n"
+    "  call void @use(%Object* null)\n"
+    "  %v1 = load %Object** %a\n"
+    "  call void @use(%Object* %v1)\n"
+    "  %obj2 = call %Object* @make()\n"
+    "  store %Object* %obj2, %Object** %b\n"
+    "  call void @use(%Object* null)\n"
+    "  %v2 = load %Object** %b\n"
+    "  call void @use(%Object* %v2)\n"
+    "  ret void\n"
+    "}\n", "f"));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_EQ(1u, markedRoots(module.get(), "f").size());
+  EXPECT_EQ(1u, allocaCount(module.get(), "f"));
+}
+
+TEST(GCRootsTest, OverlappingRootsKeepSlots) {
+  // Both roots are live across the same call.
+  OwningPtr<Module> module(optimizeRoots(std::string(declarations) +
+    "define void @f() gc \"tart-gc\" {\n" + root("a") + root("b") +
+    "  %obj1 = call %Object* @make()\n"
+    "  store %Object* %obj1, %Object** %a\n"
+    "  %obj2 = call %Object* @make()\n"
+    "  store %Object* %obj2, %Object** %b\n"
+    "  call void @use(%Object* null)\n"
+    "  %v1 = load %Object** %a\n"
+    "  %v2 = load %Object** %b\n"
+    "  call void @use(%Object* %v1)\n"
+    "  call void @use(%Object* %v2)\n"
+    "  ret void\n"
+    "}\n", "f"));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_EQ(2u, markedRoots(module.get(), "f").size());
+  EXPECT_EQ(2u, allocaCount(module.get(), "f"));
+}
+
+TEST(GCRootsTest, NotLiveAtSafePoint) {
+  // The root is loaded before any call, so it's never traced and can be promoted.
+  OwningPtr<Module> module(optimizeRoots(std::string(declarations) +
+    "define void @f(%Object* %obj) gc \"tart-gc\" {\n" + root("a") +
+    "  store %Object* %obj, %Object** %a\n"
+    "  %v = load %Object** %a\n"
+    "  call void @use(%Object* %v)\n"
+    "  ret void\n"
+    "}\n", "f"));
+  ASSERT_TRUE(module.get() != NULL);
+  EXPECT_EQ(0u, markedRoots(module.get(), "f").size());
+  EXPECT_EQ(0u, allocaCount(module.get(), "f"));
+}
+
+TEST(GCRootsTest, LiveAroundLoop) {
+  // The root is stored before the loop and loaded at the top of each iteration, so it
+  // is live across the calls at the bottom of the loop via the back edge.
+  OwningPtr<Module> module(optimizeRoots(std::string(declarations) +
+    "define void @f() gc \"tart-gc\" {\n"
+    "entry:\n" + root("a") +
+    "  %obj = call %Object* @make()\n"
+    "  store %Object* %obj, %Object** %a\n"
+    "  br label %loop\n"
+    "loop:\n"
+    "  %v = load %Object** %a\n"
+    "  call void @use(%Object* %v)\n"
+    "  %c = call i1 @more()\n"
+    "  br i1 %c, label %loop, label %exit\n"
+    "exit:\n"
+    "  ret void\n"
+    "}\n", "f"));
+  ASSERT_TRUE(module.get() != NULL);
+  std::vector<std::string> marked = markedRoots(module.get(), "f");
+  ASSERT_EQ(1u, marked.size());
+  EXPECT_EQ("a", marked[0]);
+}
@@ -0,0 +1,154 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include <gtest/gtest.h>
+#include "tart/Meta/InterfaceFile.h"
+
+#include "llvm/Module.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/OwningPtr.h"
+
+using namespace tart;
+using namespace llvm;
+
+namespace {
+
+// A library with two modules, which share a node.
+const char * library =
+  "define void @run() { ret void }\n"
+  "\n"
+  "!0 = metadata !{i32 7, metadata !\"hello\", metadata !2}\n"
+  "!1 = metadata !{i64 -1, null, void ()* @run, metadata !2}\n"
+  "!2 = metadata !{i1 true}\n"
+  "!tart.xdef.test.Second = !{!1}\n"
+  "!tart.xdef.test.First = !{!0, !2}\n";
+
+// Write the interface of 'library' to a string.
+std::string writeInterface() {
+  SMDiagnostic error;
+  OwningPtr<Module> module(ParseAssemblyString(library, NULL, error, getGlobalContext()));
+  if (module.get() == NULL) {
+    error.Print("InterfaceFileTest", errs());
+    return std::string();
+  }
+
+  InterfaceFileWriter writer;
+  if (!writer.addModule("test.First", module->getNamedMetadata("tart.xdef.test.First")) ||
+      !writer.addModule("test.Second", module->getNamedMetadata("tart.xdef.test.Second"))) {
+    return std::string();
+  }
+
+  std::string result;
+  raw_string_ostream out(result);
+  writer.write(out);
+  out.flush();
+  return result;
+}
+
+// Read an interface file from 'data'.
+InterfaceFile * readInterface(StringRef data, std::string & errorInfo) {
+  return InterfaceFile::open(MemoryBuffer::getMemBufferCopy(data), errorInfo);
+}
+
+// Set the little-endian word at 'offset' in 'data'.
+void setWord(std::string & data, uint32_t offset, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    data[offset + i] = char(value >> (i * 8));
+  }
+}
+
+}
+
+TEST(InterfaceFileTest, RoundTrip) {
+  std::string data = writeInterface();
+  ASSERT_FALSE(data.empty());
+
+  std::string errorInfo;
+  OwningPtr<InterfaceFile> file(readInterface(data, errorInfo));
+  ASSERT_TRUE(file.get() != NULL) << errorInfo;
+
+  uint32_t first, second;
+  ASSERT_TRUE(file->findModule("test.First", first));
+  ASSERT_TRUE(file->findModule("test.Second", second));
+  ASSERT_FALSE(file->findModule("test.Third", first));
+  ASSERT_TRUE(file->findModule("test.First", first));
+
+  // test.First = { !0, !2 }
+  ASSERT_EQ(2u, file->nodeSize(first));
+  ASSERT_EQ(InterfaceFile::OPERAND_NODE, file->operandKind(first, 0));
+  uint32_t node0 = file->nodeValue(first, 0);
+  ASSERT_EQ(3u, file->nodeSize(node0));
+  ASSERT_EQ(InterfaceFile::OPERAND_INT, file->operandKind(node0, 0));
+  EXPECT_EQ(32u, file->intWidth(node0, 0));
+  EXPECT_EQ(7u, file->intValue(node0, 0));
+  ASSERT_EQ(InterfaceFile::OPERAND_STRING, file->operandKind(node0, 1));
+  EXPECT_EQ("hello", file->stringValue(node0, 1));
+
+  // test.Second = { !1 }, where !1 = { i64 -1, null, @run, !2 }
+  ASSERT_EQ(1u, file->nodeSize(second));
+  uint32_t node1 = file->nodeValue(second, 0);
+  ASSERT_EQ(4u, file->nodeSize(node1));
+  EXPECT_EQ(64u, file->intWidth(node1, 0));
+  EXPECT_EQ(~uint64_t(0), file->intValue(node1, 0));
+  EXPECT_EQ(InterfaceFile::OPERAND_NULL, file->operandKind(node1, 1));
+  ASSERT_EQ(InterfaceFile::OPERAND_SYMBOL, file->operandKind(node1, 2));
+  EXPECT_EQ("run", file->stringValue(node1, 2));
+
+  // Shared nodes are only written once.
+  uint32_t node2 = file->nodeValue(first, 1);
+  EXPECT_EQ(node2, file->nodeValue(node0, 2));
+  EXPECT_EQ(node2, file->nodeValue(node1, 3));
+  ASSERT_EQ(1u, file->nodeSize(node2));
+  EXPECT_EQ(1u, file->intWidth(node2, 0));
+  EXPECT_EQ(1u, file->intValue(node2, 0));
+}
+
+TEST(InterfaceFileTest, Truncated) {
+  std::string data = writeInterface();
+  ASSERT_FALSE(data.empty());
+
+  // Every prefix of the file is rejected, whether it cuts through the header, the
+  // index tables, the operands or the string data.
+  std::string errorInfo;
+  for (size_t size = 0; size < data.size(); ++size) {
+    InterfaceFile * file = readInterface(StringRef(data).substr(0, size), errorInfo);
+    EXPECT_TRUE(file == NULL) << "size " << size;
+    delete file;
+  }
+}
+
+TEST(InterfaceFileTest, Corrupt) {
+  std::string data = writeInterface();
+  ASSERT_FALSE(data.empty());
+  const unsigned char * p = reinterpret_cast<const unsigned char *>(data.data());
+  uint32_t stringIndex = p[12] | (p[13] << 8) | (p[14] << 16) | (p[15] << 24);
+  uint32_t nodeIndex = p[20] | (p[21] << 8) | (p[22] << 16) | (p[23] << 24);
+
+  // A string which runs past the end of the file.
+  std::string errorInfo;
+  std::string badString(data);
+  setWord(badString, stringIndex + 4, 0xffffff00);
+  OwningPtr<InterfaceFile> file(readInterface(badString, errorInfo));
+  EXPECT_TRUE(file.get() == NULL);
+
+  // A node whose operands lie outside of the file.
+  std::string badNode(data);
+  setWord(badNode, nodeIndex, 0xfffffff0);
+  file.reset(readInterface(badNode, errorInfo));
+  EXPECT_TRUE(file.get() == NULL);
+
+  // An operand which refers to a node that doesn't exist. The operands of the first
+  // node start right after the module index.
+  std::string badRef(data);
+  uint32_t operands = p[nodeIndex] | (p[nodeIndex + 1] << 8) |
+      (p[nodeIndex + 2] << 16) | (p[nodeIndex + 3] << 24);
+  setWord(badRef, operands, InterfaceFile::OPERAND_NODE);
+  setWord(badRef, operands + 4, 0xffff);
+  file.reset(readInterface(badRef, errorInfo));
+  EXPECT_TRUE(file.get() == NULL);
+}
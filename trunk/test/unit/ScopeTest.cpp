@@ -5,10 +5,53 @@
 #include <gtest/gtest.h>
 #include "tart/AST/ASTDecl.h"
 #include "tart/Defn/VariableDefn.h"
+#include "tart/Defn/Scope.h"
 #include "llvm/Support/Format.h"
 
 using namespace tart;
 
+namespace {
+
+// A member loader which creates a variable for each of a fixed list of names, and
+// records the order in which they were created.
+class TestMemberLoader : public MemberLoader {
+public:
+  TestMemberLoader(IterableScope * scope, const char ** names, int count,
+      std::vector<std::string> & log)
+    : scope_(scope)
+    , names_(names)
+    , count_(count)
+    , created_(count, NULL)
+    , log_(log)
+  {}
+
+  void loadMembers(StringRef name) {
+    for (int i = 0; i < count_; ++i) {
+      if (created_[i] == NULL && name == names_[i]) {
+        created_[i] = new VariableDefn(VariableDefn::Var, NULL, names_[i]);
+        scope_->addMember(created_[i]);
+        log_.push_back(names_[i]);
+      }
+    }
+  }
+
+  void loadAllMembers(DefnList & members) {
+    for (int i = 0; i < count_; ++i) {
+      loadMembers(names_[i]);
+      members.push_back(created_[i]);
+    }
+  }
+
+private:
+  IterableScope * scope_;
+  const char ** names_;
+  int count_;
+  DefnList created_;
+  std::vector<std::string> & log_;
+};
+
+}
+
 TEST(ScopeTest, EmptyScope) {
   SymbolTable   testScope;
 
@@ -48,6 +91,40 @@ TEST(ScopeTest, LargeScope) {
   ASSERT_EQ(32u, testScope.count());
 }
 
+TEST(ScopeTest, MemberLoader) {
+  static const char * names[] = { "a", "b", "c", "d" };
+  std::vector<std::string> log;
+  IterableScope testScope;
+  testScope.setMemberLoader(new TestMemberLoader(&testScope, names, 4, log));
+
+  // Looking up a name creates only that member.
+  DefnList defs;
+  ASSERT_TRUE(testScope.lookupMember("c", defs, false));
+  ASSERT_EQ(1u, defs.size());
+  ASSERT_EQ(1u, log.size());
+  ASSERT_EQ("c", log[0]);
+
+  ASSERT_TRUE(testScope.findSymbol("a") != NULL);
+  ASSERT_EQ(2u, log.size());
+  ASSERT_EQ("a", log[1]);
+
+  // Looking up a name that isn't a member doesn't create anything.
+  defs.clear();
+  ASSERT_FALSE(testScope.lookupMember("e", defs, false));
+  ASSERT_EQ(2u, log.size());
+
+  // Iterating creates the rest, and restores declaration order.
+  Defn * de = testScope.firstMember();
+  ASSERT_EQ(4u, log.size());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(de != NULL);
+    ASSERT_EQ(StringRef(names[i]), de->name());
+    de = de->nextInScope();
+  }
+  ASSERT_TRUE(de == NULL);
+  ASSERT_EQ(4u, testScope.count());
+}
+
 #if 0
 TEST(ScopeTest, BlockScope) {
   LocalScope   parentScope(NULL);
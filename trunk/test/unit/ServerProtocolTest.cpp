@@ -0,0 +1,175 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include "config.h"
+
+#include <gtest/gtest.h>
+#include "ServerProtocol.h"
+
+#if HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H && HAVE_FORK
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace tart;
+
+namespace {
+
+/** A pipe which holds a message, written in full before the test reads it. */
+class MessagePipe {
+public:
+  MessagePipe(const std::string & data) {
+    EXPECT_EQ(0, pipe(fds_));
+    EXPECT_EQ(ssize_t(data.size()), write(fds_[1], data.data(), data.size()));
+    close(fds_[1]);
+  }
+
+  ~MessagePipe() {
+    close(fds_[0]);
+  }
+
+  int fd() const { return fds_[0]; }
+
+private:
+  int fds_[2];
+};
+
+std::string uint32Bytes(uint32_t value) {
+  return std::string(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Run readResponse on 'data', storing the output in 'output'.
+int readResponse(const std::string & data, std::string & output) {
+  MessagePipe message(data);
+  FILE * out = tmpfile();
+  int status = ServerProtocol::readResponse(message.fd(), out);
+
+  output.clear();
+  rewind(out);
+  char buffer[1024];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), out)) > 0) {
+    output.append(buffer, count);
+  }
+
+  fclose(out);
+  return status;
+}
+
+}
+
+TEST(ServerProtocolTest, StringRoundTrip) {
+  std::vector<std::string> strings;
+  strings.push_back("Hello.tart");
+  strings.push_back("");
+  strings.push_back(std::string("with\0nul", 8));
+  strings.push_back(std::string(5000, 'x'));
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  ASSERT_TRUE(ServerProtocol::writeStrings(fds[1], strings));
+  close(fds[1]);
+
+  std::vector<std::string> result;
+  result.push_back("stale");
+  EXPECT_TRUE(ServerProtocol::readStrings(fds[0], result));
+  EXPECT_TRUE(result == strings);
+  close(fds[0]);
+}
+
+TEST(ServerProtocolTest, StringsTruncated) {
+  // Two strings are announced, but the message ends in the middle of the second.
+  std::vector<std::string> result;
+  MessagePipe message(uint32Bytes(2) + uint32Bytes(3) + "abc" + uint32Bytes(3) + "d");
+  EXPECT_FALSE(ServerProtocol::readStrings(message.fd(), result));
+}
+
+TEST(ServerProtocolTest, StringsTooLarge) {
+  std::vector<std::string> result;
+  MessagePipe tooMany(uint32Bytes(0xffffffff));
+  EXPECT_FALSE(ServerProtocol::readStrings(tooMany.fd(), result));
+
+  MessagePipe tooLong(uint32Bytes(1) + uint32Bytes(0xffffffff) + "abc");
+  EXPECT_FALSE(ServerProtocol::readStrings(tooLong.fd(), result));
+
+  std::vector<std::string> strings(1, std::string(ServerProtocol::MAX_STRING_LENGTH + 1, 'x'));
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  EXPECT_FALSE(ServerProtocol::writeStrings(fds[1], strings));
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(ServerProtocolTest, Response) {
+  std::string output;
+  EXPECT_EQ(0, readResponse(std::string("ok\n\0\0", 5), output));
+  EXPECT_EQ("ok\n", output);
+
+  EXPECT_EQ(1, readResponse(std::string("\0\1", 2), output));
+  EXPECT_EQ("", output);
+
+  // Output may itself contain NUL bytes.
+  EXPECT_EQ(2, readResponse(std::string("a\0b\0\2", 5), output));
+  EXPECT_EQ(std::string("a\0b", 3), output);
+}
+
+TEST(ServerProtocolTest, ResponseTrailerSplit) {
+  // The response is read 4098 bytes at a time, so these lengths of output place the
+  // boundary between reads before, inside and after the trailer.
+  for (size_t length = 4094; length <= 4100; ++length) {
+    std::string text(length, 'x');
+    std::string output;
+    EXPECT_EQ(3, readResponse(text + std::string("\0\3", 2), output)) << length;
+    EXPECT_EQ(text, output) << length;
+  }
+}
+
+TEST(ServerProtocolTest, ResponseTruncated) {
+  // Without a trailer, everything which was received is copied.
+  std::string output;
+  EXPECT_EQ(-1, readResponse("error: abc", output));
+  EXPECT_EQ("error: abc", output);
+
+  EXPECT_EQ(-1, readResponse(std::string("error\0", 6), output));
+  EXPECT_EQ(std::string("error\0", 6), output);
+
+  EXPECT_EQ(-1, readResponse(std::string(5000, 'x'), output));
+  EXPECT_EQ(std::string(5000, 'x'), output);
+
+  EXPECT_EQ(-1, readResponse("", output));
+  EXPECT_EQ("", output);
+}
+
+TEST(ServerProtocolTest, SocketPath) {
+  char compiler[] = "/tmp/tartc-test-XXXXXX";
+  int fd = mkstemp(compiler);
+  ASSERT_GE(fd, 0);
+
+  std::vector<std::string> options;
+  options.push_back("-g");
+  std::string path = ServerProtocol::socketPath(compiler, "/work", options);
+  ASSERT_FALSE(path.empty());
+  EXPECT_EQ(path, ServerProtocol::socketPath(compiler, "/work", options));
+
+  // Each of the directory, the options and the compiler select a different server.
+  EXPECT_NE(path, ServerProtocol::socketPath(compiler, "/other", options));
+  std::vector<std::string> otherOptions(1, "-O2");
+  EXPECT_NE(path, ServerProtocol::socketPath(compiler, "/work", otherOptions));
+  std::vector<std::string> splitOptions;
+  splitOptions.push_back("-");
+  splitOptions.push_back("g");
+  EXPECT_NE(path, ServerProtocol::socketPath(compiler, "/work", splitOptions));
+
+  // Rebuilding the compiler changes its identity.
+  EXPECT_EQ(4, write(fd, "tart", 4));
+  close(fd);
+  EXPECT_NE(path, ServerProtocol::socketPath(compiler, "/work", options));
+
+  // Without a compiler, there's no server.
+  unlink(compiler);
+  EXPECT_EQ("", ServerProtocol::socketPath(compiler, "/work", options));
+}
+
+#endif
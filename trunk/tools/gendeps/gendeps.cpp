@@ -2,18 +2,24 @@
     TART - A Sweet Programming Language.
  * ================================================================ */
 
+#include "tart/Meta/InterfaceFile.h"
+
 #include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/IRReader.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/system_error.h"
 
 #include <algorithm>
+#include <map>
 #include <sstream>
 
 using namespace llvm;
@@ -25,6 +31,21 @@ static cl::opt<std::string> outputFilename("o",
     cl::desc("Output filename"),
     cl::value_desc("filename"));
 
+static cl::opt<bool> optFingerprint("fingerprint",
+    cl::desc("Output the interface fingerprint of the input module"));
+
+static cl::opt<bool> optInterface("interface",
+    cl::desc("Output a module interface file (.tif) for the input library"));
+
+static cl::opt<std::string> optSourceRoot("source-root",
+    cl::desc("Root directory of the sources of the input modules"),
+    cl::value_desc("dir"));
+
+static cl::opt<std::string> optInterfaceDir("iface-dir",
+    cl::desc("Directory containing the interface fingerprints of the modules under the "
+        "source root. Dependencies on those modules are replaced by their fingerprints."),
+    cl::value_desc("dir"));
+
 namespace {
   int xform(int c) {
     if (isalnum(c)) {
@@ -33,6 +54,148 @@ namespace {
       return '_';
     }
   }
+
+  /** If 'dep' is a source file under the source root, return its path relative to the
+      root without the extension, which is also the name of its output file without the
+      extension. Otherwise return an empty string. */
+  std::string moduleKey(const std::string & dep) {
+    const std::string & root = optSourceRoot;
+    if (optInterfaceDir.empty() || root.empty() || dep.size() <= root.size() + 6 ||
+        dep.compare(0, root.size(), root) != 0 || dep[root.size()] != '/' ||
+        !StringRef(dep).endswith(".tart")) {
+      return std::string();
+    }
+
+    return dep.substr(root.size() + 1, dep.size() - root.size() - 6);
+  }
+
+  /** The dependencies of one of the input modules. */
+  struct ModuleInfo {
+    std::string key;
+    std::vector<std::string> deps;
+    int index;
+    int lowLink;
+    int component;
+    bool onStack;
+  };
+
+  typedef std::map<std::string, ModuleInfo> ModuleMap;
+
+  /** Tarjan's algorithm: assign each module to its strongly connected component in the
+      graph of imports between the input modules. */
+  class ComponentFinder {
+  public:
+    ComponentFinder(ModuleMap & modules) : modules_(modules), nextIndex_(0), nextComponent_(0) {}
+
+    void run() {
+      for (ModuleMap::iterator it = modules_.begin(); it != modules_.end(); ++it) {
+        if (it->second.index < 0) {
+          visit(it->second);
+        }
+      }
+    }
+
+  private:
+    void visit(ModuleInfo & mi) {
+      mi.index = mi.lowLink = nextIndex_++;
+      mi.onStack = true;
+      stack_.push_back(&mi);
+      for (std::vector<std::string>::const_iterator it = mi.deps.begin(); it != mi.deps.end();
+          ++it) {
+        ModuleMap::iterator dep = modules_.find(moduleKey(*it));
+        if (dep == modules_.end()) {
+          continue;
+        }
+
+        ModuleInfo & target = dep->second;
+        if (target.index < 0) {
+          visit(target);
+          mi.lowLink = std::min(mi.lowLink, target.lowLink);
+        } else if (target.onStack) {
+          mi.lowLink = std::min(mi.lowLink, target.index);
+        }
+      }
+
+      if (mi.lowLink == mi.index) {
+        ModuleInfo * member;
+        do {
+          member = stack_.back();
+          stack_.pop_back();
+          member->onStack = false;
+          member->component = nextComponent_;
+        } while (member != &mi);
+        ++nextComponent_;
+      }
+    }
+
+    ModuleMap & modules_;
+    std::vector<ModuleInfo *> stack_;
+    int nextIndex_;
+    int nextComponent_;
+  };
+
+  /** Write 'contents' to 'path', unless the file already has those contents. Leaving the
+      file untouched means that the build doesn't consider anything which depends on it
+      to be out of date. */
+  void writeIfChanged(const std::string & path, const std::string & contents) {
+    OwningPtr<MemoryBuffer> existing;
+    if (!MemoryBuffer::getFile(path, existing) && existing->getBuffer() == contents) {
+      return;
+    }
+
+    std::string errorInfo;
+    raw_fd_ostream out(path.c_str(), errorInfo);
+    if (errorInfo.empty()) {
+      out << contents;
+    } else {
+      errs() << errorInfo;
+    }
+  }
+
+  /** Write the interfaces of all of the modules in 'library' to the interface file
+      'path'. */
+  bool writeInterface(const Module & library, const std::string & path) {
+    tart::InterfaceFileWriter writer;
+    StringRef prefix("tart.xdef.");
+    for (Module::const_named_metadata_iterator it = library.named_metadata_begin();
+        it != library.named_metadata_end(); ++it) {
+      StringRef name = it->getName();
+      if (name.startswith(prefix) &&
+          !writer.addModule(name.substr(prefix.size()), &*it)) {
+        errs() << "Cannot write the interface of module " << name.substr(prefix.size()) <<
+            "\n";
+        return false;
+      }
+    }
+
+    // Write to a temporary file and rename it into place, so that a compiler which
+    // reads the interface never sees a partially written file.
+    std::string tempPath = path + ".tmp";
+    bool existed;
+    std::string errorInfo;
+    raw_fd_ostream out(tempPath.c_str(), errorInfo, raw_fd_ostream::F_Binary);
+    if (!errorInfo.empty()) {
+      errs() << errorInfo;
+      return false;
+    }
+
+    writer.write(out);
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      errs() << "Cannot write interface file " << tempPath << "\n";
+      sys::fs::remove(tempPath, existed);
+      return false;
+    }
+
+    if (error_code ec = sys::fs::rename(tempPath, path)) {
+      errs() << "Cannot write interface file " << path << ": " << ec.message() << "\n";
+      sys::fs::remove(tempPath, existed);
+      return false;
+    }
+
+    return true;
+  }
 }
 
 int main(int argc, char **argv, char **envp) {
@@ -60,56 +223,95 @@ int main(int argc, char **argv, char **envp) {
 
   SMDiagnostic smErr;
   std::auto_ptr<Module> module;
-  Paths depPaths;
+  if (optInterface) {
+    if (filePaths.size() != 1 || outputFilename.getValue().empty()) {
+      errs() << "-interface requires one input library and an output file\n";
+      return 1;
+    }
+
+    module.reset(ParseIRFile(filePaths.front().str(), smErr, context));
+    if (module.get() == NULL) {
+      errs() << "Cannot read module " << filePaths.front().str() << "\n";
+      return 1;
+    }
+
+    return writeInterface(*module, outputFilename.getValue()) ? 0 : 1;
+  }
+
+  ModuleMap modules;
   for (Paths::iterator path = filePaths.begin(); path != filePaths.end(); ++path) {
     module.reset(ParseIRFile(path->str(), smErr, context));
-    depPaths.clear();
+    if (module.get() == NULL) {
+      errs() << "Cannot read module " << path->str() << "\n";
+      return 1;
+    }
+
+    if (optFingerprint) {
+      NamedMDNode * fp = module->getNamedMetadata("tart.interface_fingerprint");
+      if (fp != NULL && fp->getNumOperands() > 0) {
+        if (const MDString * ms = dyn_cast<MDString>(fp->getOperand(0)->getOperand(0))) {
+          ss << ms->getString().str() << "\n";
+        }
+      }
+
+      continue;
+    }
+
+    path->eraseSuffix();
+    ModuleInfo & mi = modules[path->str()];
+    mi.key = path->str();
+    mi.index = mi.lowLink = mi.component = -1;
+    mi.onStack = false;
     NamedMDNode * deps = module->getNamedMetadata("tart.module_deps");
     if (deps != NULL) {
       MDNode * node = cast<MDNode>(deps->getOperand(0));
       size_t nodeCt = node->getNumOperands();
       for (size_t i = 0; i < nodeCt; ++i) {
         if (const MDString * ms = dyn_cast<MDString>(node->getOperand(i))) {
-          depPaths.push_back(sys::Path(ms->getString()));
+          mi.deps.push_back(ms->getString());
         }
       }
-
-      if (!depPaths.empty()) {
-        // Sort the dependencies
-        std::sort(depPaths.begin(), depPaths.end());
-
-        // Print out the deps.
-        path->eraseSuffix();
-        std::string depVar(path->str());
-        std::transform(depVar.begin(), depVar.end(), depVar.begin(), xform);
-        ss << "set(" << depVar << "_DEPS\n";
-        for (Paths::iterator it = depPaths.begin(); it != depPaths.end(); ++it) {
-          ss << "    \"" << it->str() << "\"\n";
-        }
-
-        ss << ")\n\n";
-      }
     }
   }
 
-  if (!outputFilename.getValue().empty()) {
-    // First, attempt to read the file and see if it changed.
-    sys::PathWithStatus outPath(outputFilename.getValue());
-    if (outPath.canRead()) {
-      const sys::FileStatus * fstat = outPath.getFileStatus();
-      if (fstat != NULL) {
-        //size_t bufSize = fstat->fileSize;
+  // A module depends on the interface fingerprints of the modules it imports, except for
+  // those which also import it, directly or indirectly. Within such a cycle the module
+  // has to depend on the sources, since the fingerprints themselves depend on each other.
+  ComponentFinder(modules).run();
+  Paths depPaths;
+  for (ModuleMap::const_iterator it = modules.begin(); it != modules.end(); ++it) {
+    const ModuleInfo & mi = it->second;
+    if (mi.deps.empty()) {
+      continue;
+    }
+
+    depPaths.clear();
+    for (std::vector<std::string>::const_iterator dep = mi.deps.begin(); dep != mi.deps.end();
+        ++dep) {
+      ModuleMap::const_iterator target = modules.find(moduleKey(*dep));
+      if (target != modules.end() && target->second.component != mi.component) {
+        depPaths.push_back(sys::Path(optInterfaceDir + "/" + target->first + ".iface"));
+      } else {
+        depPaths.push_back(sys::Path(*dep));
       }
     }
 
-    std::string depErr;
-    raw_fd_ostream depOut(outPath.c_str(), depErr);
-    if (depErr.empty()) {
-      depOut << ss.str();
-    } else {
-      errs() << depErr;
+    // Sort the dependencies
+    std::sort(depPaths.begin(), depPaths.end());
+
+    // Print out the deps.
+    std::string depVar(mi.key);
+    std::transform(depVar.begin(), depVar.end(), depVar.begin(), xform);
+    ss << "set(" << depVar << "_DEPS\n";
+    for (Paths::iterator it = depPaths.begin(); it != depPaths.end(); ++it) {
+      ss << "    \"" << it->str() << "\"\n";
     }
-    depOut.close();
+
+    ss << ")\n\n";
+  }
+
+  if (!outputFilename.getValue().empty()) {
+    writeIfChanged(outputFilename.getValue(), ss.str());
   } else {
     outs() << ss.str();
   }
@@ -0,0 +1,174 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include "config.h"
+
+#include "CompileServer.h"
+#include "ServerProtocol.h"
+
+#include "tart/Common/Diagnostics.h"
+#include "tart/Common/Compiler.h"
+#include "tart/Common/PackageMgr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <stdio.h>
+
+#if HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H && HAVE_FORK
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace tart {
+
+int CompileServer::run(unsigned idleSeconds) {
+  executableId_ = ServerProtocol::fileIdentity(executable_);
+  if (executableId_ == 0 || !listen()) {
+    return 1;
+  }
+
+  // Jobs are never waited for, so let the system reap them. A client which goes away
+  // shouldn't kill the server.
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  for (;;) {
+    fd_set readFds;
+    FD_ZERO(&readFds);
+    FD_SET(listenFd_, &readFds);
+    struct timeval timeout = { time_t(idleSeconds), 0 };
+    int ready = select(listenFd_ + 1, &readFds, NULL, NULL, &timeout);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    } else if (ready <= 0) {
+      break;
+    }
+
+    int fd = accept(listenFd_, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+
+    // If anything the server has loaded is out of date, the client has to compile the
+    // file itself. The next client will start a new server.
+    if (isOutOfDate()) {
+      ServerProtocol::writeTrailer(fd, ServerProtocol::STATUS_UNAVAILABLE);
+      close(fd);
+      break;
+    }
+
+    startJob(fd);
+    close(fd);
+  }
+
+  close(listenFd_);
+  unlink(socketPath_.c_str());
+  return 0;
+}
+
+bool CompileServer::isOutOfDate() const {
+  // A rebuilt compiler would otherwise keep being replaced by this one, for as long as
+  // jobs kept arriving before the idle timeout.
+  return ServerProtocol::fileIdentity(executable_) != executableId_ ||
+      PackageMgr::get().isModifiedSince(startTime_);
+}
+
+bool CompileServer::listen() {
+  struct sockaddr_un addr;
+  if (socketPath_.size() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socketPath_.c_str());
+
+  listenFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd_ < 0) {
+    return false;
+  }
+
+  if (bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    if (errno != EADDRINUSE) {
+      close(listenFd_);
+      return false;
+    }
+
+    // If a server is already listening, leave it alone; otherwise the socket was left
+    // behind by a server which died, and can be replaced.
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    if (probe >= 0) {
+      close(probe);
+    }
+
+    if (live || unlink(socketPath_.c_str()) != 0 ||
+        bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      close(listenFd_);
+      return false;
+    }
+  }
+
+  if (::listen(listenFd_, 64) != 0) {
+    close(listenFd_);
+    unlink(socketPath_.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void CompileServer::startJob(int fd) {
+  std::vector<std::string> inputFiles;
+  if (!ServerProtocol::readStrings(fd, inputFiles)) {
+    return;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    ServerProtocol::writeTrailer(fd, ServerProtocol::STATUS_UNAVAILABLE);
+    return;
+  } else if (pid > 0) {
+    return;
+  }
+
+  // In the job process: send all of the compiler's output to the client.
+  close(listenFd_);
+  signal(SIGPIPE, SIG_DFL);
+  dup2(fd, STDOUT_FILENO);
+  dup2(fd, STDERR_FILENO);
+
+  Compiler compiler;
+  for (std::vector<std::string>::const_iterator it = inputFiles.begin();
+      it != inputFiles.end(); ++it) {
+    compiler.processInputFile(*it);
+  }
+
+  llvm::outs().flush();
+  llvm::errs().flush();
+  fflush(stdout);
+  fflush(stderr);
+  ServerProtocol::writeTrailer(fd, diag.getErrorCount() != 0);
+  _exit(0);
+}
+
+}
+
+#else
+
+namespace tart {
+
+int CompileServer::run(unsigned idleSeconds) {
+  fprintf(stderr, "The compile server is not supported on this platform\n");
+  return 1;
+}
+
+}
+
+#endif
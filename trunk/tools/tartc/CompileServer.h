@@ -0,0 +1,64 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_TOOLS_COMPILESERVER_H
+#define TART_TOOLS_COMPILESERVER_H
+
+#include "llvm/Support/TimeValue.h"
+
+#include <string>
+
+#include <stdint.h>
+
+namespace tart {
+
+/// -------------------------------------------------------------------
+/// A long-lived compiler process, which loads the builtins and the system classes once,
+/// and then compiles the files sent to it by tartcc clients.
+///
+/// Each job runs in a process forked from the server, so that every compilation starts
+/// from the same warm state, jobs from a parallel build run in parallel, and a crash or
+/// a fatal error only takes down the job. If any file loaded by the server changes, or the
+/// compiler executable itself is rebuilt, the server refuses further jobs and exits, and
+/// the clients fall back to running tartc.
+class CompileServer {
+public:
+  /** Create a server which listens on 'socketPath'. 'executable' is the path of the
+      compiler, as used by the clients. 'startTime' is the time at which the server began
+      loading modules. */
+  CompileServer(const std::string & socketPath, const std::string & executable,
+      const llvm::sys::TimeValue & startTime)
+    : socketPath_(socketPath)
+    , executable_(executable)
+    , startTime_(startTime)
+    , executableId_(0)
+    , listenFd_(-1)
+  {}
+
+  /** Accept and run jobs until the server has been idle for 'idleSeconds', or becomes
+      out of date. Returns the exit status of the server. */
+  int run(unsigned idleSeconds);
+
+private:
+  /** Create the listening socket. Returns false if the socket could not be created, or
+      if another server is already listening on it. */
+  bool listen();
+
+  /** Return true if anything the server has loaded, or the server's own executable, has
+      changed since it started. */
+  bool isOutOfDate() const;
+
+  /** Run the job received on 'fd' in a child process. */
+  void startJob(int fd);
+
+  std::string socketPath_;
+  std::string executable_;
+  llvm::sys::TimeValue startTime_;
+  uint64_t executableId_;
+  int listenFd_;
+};
+
+}
+
+#endif // TART_TOOLS_COMPILESERVER_H
@@ -0,0 +1,159 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include "config.h"
+
+#include "ParallelCompiler.h"
+
+#include "tart/Common/Diagnostics.h"
+#include "tart/Common/Compiler.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <stdio.h>
+
+#if HAVE_FORK
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+namespace tart {
+
+struct ParallelCompiler::Job {
+  pid_t pid;
+  int fd;
+  std::string output;
+};
+
+bool ParallelCompiler::compile(const std::vector<std::string> & inputFiles) {
+  std::vector<Job> jobs;
+  bool success = true;
+  size_t next = 0;
+  while (next < inputFiles.size() || !jobs.empty()) {
+    // A file which can't be given a process is reported once and skipped; the
+    // remaining files are still compiled.
+    while (next < inputFiles.size() && jobs.size() < maxJobs_) {
+      Job job;
+      const std::string & inputFile = inputFiles[next++];
+      if (startJob(inputFile, job)) {
+        jobs.push_back(job);
+      } else {
+        fprintf(stderr, "Unable to start a process to compile '%s'\n", inputFile.c_str());
+        success = false;
+      }
+    }
+
+    if (jobs.empty()) {
+      break;
+    }
+
+    success &= pollJobs(jobs);
+  }
+
+  return success;
+}
+
+bool ParallelCompiler::startJob(const std::string & inputFile, Job & job) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return false;
+  }
+
+  // Anything still buffered would otherwise be written by the job as well.
+  llvm::outs().flush();
+  fflush(NULL);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  } else if (pid == 0) {
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[1]);
+
+    Compiler compiler;
+    compiler.processInputFile(inputFile);
+
+    llvm::outs().flush();
+    llvm::errs().flush();
+    fflush(NULL);
+    _exit(diag.getErrorCount() != 0);
+  }
+
+  close(fds[1]);
+  job.pid = pid;
+  job.fd = fds[0];
+  return true;
+}
+
+bool ParallelCompiler::pollJobs(std::vector<Job> & jobs) {
+  fd_set readFds;
+  FD_ZERO(&readFds);
+  int maxFd = -1;
+  for (std::vector<Job>::const_iterator it = jobs.begin(); it != jobs.end(); ++it) {
+    FD_SET(it->fd, &readFds);
+    if (it->fd > maxFd) {
+      maxFd = it->fd;
+    }
+  }
+
+  if (select(maxFd + 1, &readFds, NULL, NULL, NULL) < 0) {
+    return errno == EINTR;
+  }
+
+  bool success = true;
+  for (std::vector<Job>::iterator it = jobs.begin(); it != jobs.end();) {
+    if (FD_ISSET(it->fd, &readFds)) {
+      char buffer[4096];
+      ssize_t count = read(it->fd, buffer, sizeof(buffer));
+      if (count > 0) {
+        it->output.append(buffer, count);
+      } else if (count == 0 || errno != EINTR) {
+        // The job has finished. Print its output in one piece, so that the diagnostics
+        // for different files don't get mixed up.
+        close(it->fd);
+        int status = 0;
+        while (waitpid(it->pid, &status, 0) < 0 && errno == EINTR) {}
+        fwrite(it->output.data(), 1, it->output.size(), stderr);
+        fflush(stderr);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          success = false;
+        }
+
+        it = jobs.erase(it);
+        continue;
+      }
+    }
+
+    ++it;
+  }
+
+  return success;
+}
+
+}
+
+#else
+
+namespace tart {
+
+bool ParallelCompiler::compile(const std::vector<std::string> & inputFiles) {
+  // Without fork(), compile the files one at a time.
+  Compiler compiler;
+  for (std::vector<std::string>::const_iterator it = inputFiles.begin();
+      it != inputFiles.end(); ++it) {
+    compiler.processInputFile(*it);
+  }
+
+  return diag.getErrorCount() == 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_TOOLS_PARALLELCOMPILER_H
+#define TART_TOOLS_PARALLELCOMPILER_H
+
+#include <string>
+#include <vector>
+
+namespace tart {
+
+/// -------------------------------------------------------------------
+/// Compiles several independent input files at once.
+///
+/// The compiler's heap, builtins and diagnostics are process-wide, so rather than
+/// running the compiler on several threads, each input file is compiled in a process
+/// forked from one which has already loaded the builtins and the system classes. The
+/// loaded modules are shared between the jobs by copy-on-write. The output of each job
+/// is collected, and printed as a unit when the job finishes.
+class ParallelCompiler {
+public:
+  ParallelCompiler(unsigned maxJobs) : maxJobs_(maxJobs) {}
+
+  /** Compile all of the input files. Returns true if they all compiled without errors. */
+  bool compile(const std::vector<std::string> & inputFiles);
+
+private:
+  struct Job;
+
+  /** Start a process which compiles 'inputFile'. Returns false if it could not be started. */
+  bool startJob(const std::string & inputFile, Job & job);
+
+  /** Wait for output from any running job, and finish any jobs which have exited.
+      Returns false if any job that finished failed. */
+  bool pollJobs(std::vector<Job> & jobs);
+
+  unsigned maxJobs_;
+};
+
+}
+
+#endif // TART_TOOLS_PARALLELCOMPILER_H
@@ -0,0 +1,230 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#include "config.h"
+
+#include "ServerProtocol.h"
+
+#if HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H && HAVE_FORK
+
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace tart {
+namespace ServerProtocol {
+
+namespace {
+  /** Write all of 'size' bytes, retrying after interruptions and short writes. */
+  bool writeAll(int fd, const void * data, size_t size) {
+    const char * pos = static_cast<const char *>(data);
+    while (size > 0) {
+      ssize_t count = write(fd, pos, size);
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        return false;
+      }
+
+      pos += count;
+      size -= count;
+    }
+
+    return true;
+  }
+
+  /** Read exactly 'size' bytes. Returns false on error or end of file. */
+  bool readAll(int fd, void * data, size_t size) {
+    char * pos = static_cast<char *>(data);
+    while (size > 0) {
+      ssize_t count = read(fd, pos, size);
+      if (count < 0 && errno == EINTR) {
+        continue;
+      } else if (count <= 0) {
+        return false;
+      }
+
+      pos += count;
+      size -= count;
+    }
+
+    return true;
+  }
+
+  /** 64-bit FNV-1a hash of 'str', combined with 'hash'. */
+  uint64_t hashString(uint64_t hash, const std::string & str) {
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++it) {
+      hash = (hash ^ uint8_t(*it)) * 1099511628211ull;
+    }
+
+    // Separate the strings, so that "ab", "c" differs from "a", "bc".
+    return (hash ^ 0xff) * 1099511628211ull;
+  }
+
+  /** 64-bit FNV-1a hash of 'value', combined with 'hash'. */
+  uint64_t hashValue(uint64_t hash, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      hash = (hash ^ uint8_t(value >> (i * 8))) * 1099511628211ull;
+    }
+
+    return hash;
+  }
+
+  /** Return the directory which holds the current user's server sockets, creating it if
+      necessary, or an empty string if it can't be used safely. The directory must belong
+      to the user and be inaccessible to anyone else, since a socket in a shared
+      directory could be bound first by another user, who could then feed fake results
+      to the user's builds. */
+  std::string socketDir() {
+    char dir[64];
+    snprintf(dir, sizeof(dir), "/tmp/tartc-%u", unsigned(getuid()));
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+      return std::string();
+    }
+
+    // Check the directory itself, rather than whatever a symbolic link points to.
+    struct stat st;
+    if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() ||
+        (st.st_mode & 077) != 0) {
+      return std::string();
+    }
+
+    return dir;
+  }
+}
+
+bool isInputFile(const std::string & arg) {
+  return arg.size() > 5 && arg.compare(arg.size() - 5, 5, ".tart") == 0;
+}
+
+uint64_t fileIdentity(const std::string & path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return 0;
+  }
+
+  uint64_t hash = 14695981039346656037ull;
+  hash = hashValue(hash, uint64_t(st.st_dev));
+  hash = hashValue(hash, uint64_t(st.st_ino));
+  hash = hashValue(hash, uint64_t(st.st_size));
+  hash = hashValue(hash, uint64_t(st.st_mtime));
+  return hash;
+}
+
+std::string socketPath(const std::string & compiler, const std::string & workingDir,
+    const std::vector<std::string> & options) {
+  std::string dir = socketDir();
+  uint64_t compilerId = fileIdentity(compiler);
+  if (dir.empty() || compilerId == 0) {
+    return std::string();
+  }
+
+  uint64_t hash = 14695981039346656037ull;
+  hash = hashString(hash, compiler);
+  hash = hashValue(hash, compilerId);
+  hash = hashString(hash, workingDir);
+  for (std::vector<std::string>::const_iterator it = options.begin(); it != options.end();
+      ++it) {
+    hash = hashString(hash, *it);
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "/%08x%08x.sock", unsigned(hash >> 32), unsigned(hash));
+  return dir + name;
+}
+
+bool writeStrings(int fd, const std::vector<std::string> & strings) {
+  if (strings.size() > MAX_STRINGS) {
+    return false;
+  }
+
+  uint32_t count = strings.size();
+  if (!writeAll(fd, &count, sizeof(count))) {
+    return false;
+  }
+
+  for (std::vector<std::string>::const_iterator it = strings.begin(); it != strings.end();
+      ++it) {
+    if (it->size() > MAX_STRING_LENGTH) {
+      return false;
+    }
+
+    uint32_t length = it->size();
+    if (!writeAll(fd, &length, sizeof(length)) || !writeAll(fd, it->data(), length)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool readStrings(int fd, std::vector<std::string> & strings) {
+  uint32_t count;
+  if (!readAll(fd, &count, sizeof(count)) || count > MAX_STRINGS) {
+    return false;
+  }
+
+  strings.clear();
+  strings.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t length;
+    if (!readAll(fd, &length, sizeof(length)) || length > MAX_STRING_LENGTH) {
+      return false;
+    }
+
+    std::string str(length, '\0');
+    if (length > 0 && !readAll(fd, &str[0], length)) {
+      return false;
+    }
+
+    strings.push_back(str);
+  }
+
+  return true;
+}
+
+bool writeTrailer(int fd, int status) {
+  char trailer[2] = { 0, char(status) };
+  return writeAll(fd, trailer, sizeof(trailer));
+}
+
+int readResponse(int fd, FILE * out) {
+  // The last two bytes read are held back, since they may be the trailer.
+  char buffer[4096 + 2];
+  size_t held = 0;
+  for (;;) {
+    ssize_t count = read(fd, buffer + held, sizeof(buffer) - held);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    } else if (count <= 0) {
+      break;
+    }
+
+    held += count;
+    if (held > 2) {
+      fwrite(buffer, 1, held - 2, out);
+      memmove(buffer, buffer + held - 2, 2);
+      held = 2;
+    }
+  }
+
+  if (held == 2 && buffer[0] == '\0') {
+    fflush(out);
+    return (unsigned char)buffer[1];
+  }
+
+  fwrite(buffer, 1, held, out);
+  fflush(out);
+  return -1;
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,68 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+#ifndef TART_TOOLS_SERVERPROTOCOL_H
+#define TART_TOOLS_SERVERPROTOCOL_H
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace tart {
+
+/// -------------------------------------------------------------------
+/// The protocol spoken between the tartc compile server and the tartcc client.
+///
+/// A server is started with the options which are common to every compilation in a
+/// directory, and listens on a Unix domain socket whose name is derived from those
+/// options and from the identity of the compiler executable, so that clients with
+/// different options, or with a rebuilt compiler, never share a server. Sockets live in
+/// a directory which only the user can access. The client
+/// sends the list of input files; the server replies with the compiler's output,
+/// followed by a trailer consisting of a NUL byte and the exit status.
+namespace ServerProtocol {
+
+/** Exit status which tells the client to run the compiler itself, because the server
+    could not handle the request. */
+static const int STATUS_UNAVAILABLE = 255;
+
+/** Limits on the lists of strings which are exchanged, so that a bad peer can't make
+    the reader allocate arbitrary amounts of memory. */
+static const uint32_t MAX_STRINGS = 0x10000;
+static const uint32_t MAX_STRING_LENGTH = 0x10000;
+
+/** Return true if 'arg' is the name of an input file rather than an option. */
+bool isInputFile(const std::string & arg);
+
+/** Return a hash of the device, inode, size and modification time of the file at 'path',
+    which changes whenever the file is rebuilt; or 0 if the file can't be found. */
+uint64_t fileIdentity(const std::string & path);
+
+/** Return the path of the socket of the server for the specified compiler executable,
+    working directory and options; or an empty string if there is no safe place for the
+    socket, in which case the compiler should be run directly. */
+std::string socketPath(const std::string & compiler, const std::string & workingDir,
+    const std::vector<std::string> & options);
+
+/** Write a list of strings to 'fd'. Returns false on error. */
+bool writeStrings(int fd, const std::vector<std::string> & strings);
+
+/** Read a list of strings written by writeStrings. Returns false on error, or if the
+    list exceeds the limits above. */
+bool readStrings(int fd, std::vector<std::string> & strings);
+
+/** Write the trailer which ends a response. */
+bool writeTrailer(int fd, int status);
+
+/** Copy a response from 'fd' to 'out', and return the exit status from the trailer,
+    or -1 if the connection was closed before the trailer was sent. */
+int readResponse(int fd, FILE * out);
+
+}
+
+}
+
+#endif // TART_TOOLS_SERVERPROTOCOL_H
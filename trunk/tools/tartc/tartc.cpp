@@ -19,6 +19,9 @@
 
 #include "config_paths.h"
 
+#include "CompileServer.h"
+#include "ParallelCompiler.h"
+
 using namespace tart;
 using namespace llvm;
 using namespace llvm::sys;
@@ -37,6 +40,18 @@ InputFilenames(cl::Positional, cl::desc("<input files>"));
 static cl::opt<bool>
 NoStdInc("nostdlib", cl::desc("Don't add the standard libraries to the module import path list"));
 
+static cl::opt<unsigned>
+Jobs("j", cl::Prefix, cl::desc("Number of input files to compile at once"),
+    cl::value_desc("N"), cl::init(1));
+
+static cl::opt<std::string>
+ServerSocket("server", cl::desc("Run as a compile server, listening on the specified socket"),
+    cl::value_desc("socket"));
+
+static cl::opt<unsigned>
+ServerIdleTimeout("server-idle-timeout",
+    cl::desc("Number of seconds after which an idle compile server exits"), cl::init(600));
+
 int main(int argc, char **argv) {
   PrintStackTraceOnErrorSignal();
   cl::ParseCommandLineOptions(argc, argv, " tart\n");
@@ -46,12 +61,16 @@ int main(int argc, char **argv) {
   InitializeAllTargets();
   InitializeAllTargetMCs();
 
-  // Requires at least one input file
-  if (InputFilenames.empty()) {
+  // Requires at least one input file, unless the files will be supplied by clients.
+  if (InputFilenames.empty() && ServerSocket.empty()) {
     fprintf(stderr, "No input files specified\n");
     return -1;
   }
 
+  // Anything loaded after this point which changes invalidates the server.
+  TimeValue startTime = TimeValue::now();
+  startTime.nanoseconds(0);
+
   GC::init();
 
   // Add the module search paths.
@@ -73,6 +92,22 @@ int main(int argc, char **argv) {
   Builtins::init();
   Builtins::loadSystemClasses();
 
+  if (!ServerSocket.empty()) {
+    if (diag.getErrorCount() != 0) {
+      return 1;
+    }
+
+    return CompileServer(ServerSocket, argv[0], startTime).run(ServerIdleTimeout);
+  }
+
+  // Independent input files can be compiled concurrently, once the system classes
+  // have been loaded.
+  if (Jobs > 1 && InputFilenames.size() > 1 && diag.getErrorCount() == 0) {
+    bool success = ParallelCompiler(Jobs).compile(InputFilenames);
+    GC::uninit();
+    return !success;
+  }
+
   // Process the input files.
   Compiler compiler;
   for (unsigned i = 0, e = InputFilenames.size(); i != e; ++i) {
@@ -0,0 +1,174 @@
+/* ================================================================ *
+    TART - A Sweet Programming Language.
+ * ================================================================ */
+
+/* Client for the tartc compile server.
+
+   Usage: tartcc <path to tartc> [tartc options] <input files>
+
+   Sends the input files to a tartc server started with the same options in the same
+   directory, starting the server if there isn't one. If the server can't be reached,
+   or can't handle the request, tartc is run directly, so tartcc can always be used in
+   place of tartc. */
+
+#include "config.h"
+
+#include "ServerProtocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H && HAVE_FORK
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+using namespace tart;
+
+namespace {
+  /** Connect to the server listening on 'socketPath'. Returns the socket, or -1. */
+  int connectToServer(const std::string & socketPath) {
+    struct sockaddr_un addr;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+      return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      close(fd);
+      fd = -1;
+    }
+
+    return fd;
+  }
+
+  /** Start a server in the background, detached from the build. */
+  void startServer(const char * compiler, const std::string & socketPath,
+      const std::vector<std::string> & options) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      return;
+    } else if (pid > 0) {
+      waitpid(pid, NULL, 0);
+      return;
+    }
+
+    // Fork again so that the server is not a child of the build tool.
+    setsid();
+    if (fork() != 0) {
+      _exit(0);
+    }
+
+    // Errors while starting the server will be reported when the file is compiled
+    // directly, so its output is discarded.
+    int devNull = open("/dev/null", O_RDWR);
+    if (devNull >= 0) {
+      dup2(devNull, STDIN_FILENO);
+      dup2(devNull, STDOUT_FILENO);
+      dup2(devNull, STDERR_FILENO);
+    }
+
+    std::string serverOption("-server=");
+    serverOption.append(socketPath);
+    std::vector<const char *> args;
+    args.push_back(compiler);
+    args.push_back(serverOption.c_str());
+    for (std::vector<std::string>::const_iterator it = options.begin(); it != options.end();
+        ++it) {
+      args.push_back(it->c_str());
+    }
+
+    args.push_back(NULL);
+    execv(compiler, const_cast<char * const *>(&args[0]));
+    _exit(1);
+  }
+
+  /** Send a job to the server for the specified options. Returns the exit status, or
+      STATUS_UNAVAILABLE if the compiler should be run directly. */
+  int compileWithServer(const char * compiler, const std::vector<std::string> & options,
+      const std::vector<std::string> & inputFiles) {
+    char workingDir[PATH_MAX];
+    if (getcwd(workingDir, sizeof(workingDir)) == NULL) {
+      return ServerProtocol::STATUS_UNAVAILABLE;
+    }
+
+    std::string socketPath = ServerProtocol::socketPath(compiler, workingDir, options);
+    if (socketPath.empty()) {
+      return ServerProtocol::STATUS_UNAVAILABLE;
+    }
+
+    int fd = connectToServer(socketPath);
+    if (fd < 0) {
+      startServer(compiler, socketPath, options);
+
+      // Wait up to 20 seconds for the server to finish loading the standard library.
+      for (int i = 0; i < 400 && fd < 0; ++i) {
+        usleep(50000);
+        fd = connectToServer(socketPath);
+      }
+
+      if (fd < 0) {
+        return ServerProtocol::STATUS_UNAVAILABLE;
+      }
+    }
+
+    int status = ServerProtocol::STATUS_UNAVAILABLE;
+    if (ServerProtocol::writeStrings(fd, inputFiles)) {
+      status = ServerProtocol::readResponse(fd, stderr);
+      if (status < 0) {
+        fprintf(stderr, "tartcc: compile server job terminated abnormally\n");
+        status = 1;
+      }
+    }
+
+    close(fd);
+    return status;
+  }
+}
+
+#endif
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: tartcc <path to tartc> [tartc options] <input files>\n");
+    return 1;
+  }
+
+  const char * compiler = argv[1];
+
+#if HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H && HAVE_FORK
+  std::vector<std::string> options;
+  std::vector<std::string> inputFiles;
+  for (int i = 2; i < argc; ++i) {
+    if (ServerProtocol::isInputFile(argv[i])) {
+      inputFiles.push_back(argv[i]);
+    } else {
+      options.push_back(argv[i]);
+    }
+  }
+
+  if (!inputFiles.empty() && getenv("TART_NO_COMPILE_SERVER") == NULL) {
+    int status = compileWithServer(compiler, options, inputFiles);
+    if (status != ServerProtocol::STATUS_UNAVAILABLE) {
+      return status;
+    }
+  }
+#endif
+
+  // Run the compiler directly.
+  execv(compiler, argv + 1);
+  fprintf(stderr, "tartcc: cannot execute '%s'\n", compiler);
+  return 1;
+}
@@ -34,6 +34,7 @@
 
 #include "tart/Reflect/ReflectorPass.h"
 #include "tart/Reflect/StaticRoots.h"
+#include "tart/Opt/Devirtualize.h"
 
 #include <memory>
 #include <cstring>
@@ -127,6 +128,9 @@ static cl::opt<OptLevel> optOptimizationLevel(cl::init(O0),
 static cl::opt<bool> optDisableInline("disable-inlining",
     cl::desc("Do not run the inliner pass"));
 
+static cl::opt<bool> optDisableDevirtualize("disable-devirtualization",
+    cl::desc("Do not replace virtual calls having a single target with direct calls"));
+
 static cl::opt<bool> optInternalize("internalize",
     cl::desc("Mark all symbols as internal except for 'main'"));
 
@@ -206,6 +210,8 @@ void optimize(Module * module, const TargetData * targetData) {
     externs.push_back("main");
     externs.push_back("String_create");
     externs.push_back("TraceAction_traceDescriptors");
+    externs.push_back("ParallelTask_run");
+    externs.push_back("Thread_run");
     externs.push_back("GC_static_roots");
     passes.add(createInternalizePass(externs)); // Internalize all but exported API symbols.
   }
@@ -219,6 +225,12 @@ void optimize(Module * module, const TargetData * targetData) {
     passes.add(createStripDeadDebugInfoPass());
   }
 
+  // The whole program is visible when linking an executable, so calls whose receiver can
+  // only be of one class can be made direct, before the inliner runs.
+  if (!optLinkAsLibrary && optOptimizationLevel > O0 && !optDisableDevirtualize) {
+    addPass(passes, new tart::Devirtualize());
+  }
+
   if (optOptimizationLevel > O0) {
     // Add an appropriate TargetData instance for this module...
     if (targetData) {